@@ -21,6 +21,9 @@
 #include "ShiftManager.h"
 #include "Shared\holefinder.h"
 
+// Number of contours per thread for the per-contour loops
+#define CONTS_PER_THREAD 20.
+
 #if defined(_DEBUG) && defined(_CRTDBG_MAP_ALLOC)
 #define new DEBUG_NEW
 #endif
@@ -1157,6 +1160,7 @@ UINT CAutoContouringDlg::AutoContProc(LPVOID pParam)
   Iobj *objSingle = NULL;
   int coNum, pt;
   Icont *cont;
+  IntVec outside;
   bool targetIsPix = acd->targetSizeOrPix < 10.;
   bool doSingle = acd->singleXcen >= 0 && acd->singleYcen >= 0.;
   int mode = image->getType();
@@ -1404,6 +1408,8 @@ UINT CAutoContouringDlg::AutoContProc(LPVOID pParam)
   if (!acd->imIsBytes) {
     scaleFac = 255.f / (maxScale - minScale);
     acd->useThresh = (acd->useThresh - minScale) * scaleFac;
+#pragma omp parallel for num_threads(numThreads) \
+  shared(nxRed, nyRed, acd, minScale, scaleFac) private(ix, iy, val, fval)
     for (iy = 0; iy < nyRed; iy++) {
       for (ix = 0; ix < nxRed; ix++) {
         sliceGetVal(acd->slReduced, ix, iy, val);
@@ -1427,8 +1433,13 @@ UINT CAutoContouringDlg::AutoContProc(LPVOID pParam)
   if (acd->obj->contsize)
     SquareStatistics(acd, nxRed, nyRed, minScale, maxScale, redFac, 2.25f);
 
-  // Scale the contours back to full image coordinates and find the one around the
+  // Scale the contours back to full image coordinates, then find the one around the
   // clicked point
+  numThreads = B3DNINT(acd->obj->contsize / CONTS_PER_THREAD);
+  B3DCLAMP(numThreads, 1, MAX_AUTO_SLICE_THREADS);
+  numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(acd, redFac, xOffset, yOffset) private(coNum, cont, pt)
   for (coNum = 0; coNum < acd->obj->contsize; coNum++) {
     cont = &acd->obj->cont[coNum];
     for (pt = 0; pt < cont->psize; pt++) {
@@ -1436,9 +1447,10 @@ UINT CAutoContouringDlg::AutoContProc(LPVOID pParam)
       cont->pts[pt].y = cont->pts[pt].y * redFac + yOffset;
     }
     imodContourReduce(cont, 0.75);
-    if (doSingle && imodPointInsideCont(cont, &ptSingle))
-      coSingle = coNum;
   }
+  for (coNum = 0; coNum < acd->obj->contsize && doSingle; coNum++)
+    if (imodPointInsideCont(&acd->obj->cont[coNum], &ptSingle))
+      coSingle = coNum;
   if (doSingle) {
     if (coSingle >= 0) {
 
@@ -1464,12 +1476,18 @@ UINT CAutoContouringDlg::AutoContProc(LPVOID pParam)
     return 1;
   }
 
-  // If polygon, find contours fully inside it
+  // If polygon, find contours fully inside it, testing them in parallel
   if (acd->polygon) {
     ptX = &acd->polygon->mPtX[0];
     ptY = &acd->polygon->mPtY[0];
     listSize = acd->polygon->mNumPoints;
-    for (coNum = acd->obj->contsize - 1; coNum >= 0; coNum--) {
+    outside.resize(acd->obj->contsize, 0);
+    numThreads = B3DNINT(acd->obj->contsize / CONTS_PER_THREAD);
+    B3DCLAMP(numThreads, 1, MAX_AUTO_SLICE_THREADS);
+    numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(acd, ptX, ptY, listSize, outside) private(coNum, cont, ll, ur, pt)
+    for (coNum = 0; coNum < acd->obj->contsize; coNum++) {
       cont = &acd->obj->cont[coNum];
 
       // Get bounding box, if all points inside, it is good
@@ -1481,15 +1499,17 @@ UINT CAutoContouringDlg::AutoContProc(LPVOID pParam)
          continue;
       }
 
-      // Otherwise, test every point, if one is outside, break and remove contour
-      ind = 0;
+      // Otherwise, test every point, if one is outside, break and mark for removal
       for (pt = 0; pt < cont->psize; pt++) {
         if (!InsideContour(ptX, ptY, listSize, cont->pts[pt].x, cont->pts[pt].y)) {
-          ind++;
+          outside[coNum] = 1;
           break;
         }
       }
-      if (ind) {
+    }
+
+    for (coNum = acd->obj->contsize - 1; coNum >= 0; coNum--) {
+      if (outside[coNum]) {
 
         // Yes, this is how a contour is deleted.  Have to adjust statistics too
         acd->obj->contsize--;
@@ -1677,7 +1697,7 @@ void CAutoContouringDlg::SquareStatistics(AutoContData *acd, int nxRed, int nyRe
   float avgAngle, cosAng, sinAng, xVecs[3], yVecs[3];
   float half, delx, dely, left, right, scaleForScan, area, sizeScale = redFac;
   double sum, sumsq;
-  int minForScan = 30, maxSize = 0;
+  int minForScan = 30, numThreads;
   Icont *cont, *rotCont, *scanCont;
   Ipoint bbMin, bbMax, tpt;
   FloatVec tmpVec, valVec, xCenters, yCenters, xBound, yBound, peaks, altPeaks;
@@ -1705,7 +1725,17 @@ void CAutoContouringDlg::SquareStatistics(AutoContData *acd, int nxRed, int nyRe
   xBound.resize(numConts);
   yBound.resize(numConts);
 
-
+  // The contours are independent, so do them in parallel; they vary in size so hand
+  // them out dynamically
+  numThreads = B3DNINT(numConts / CONTS_PER_THREAD);
+  B3DCLAMP(numThreads, 1, MAX_AUTO_SLICE_THREADS);
+  numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic) \
+  shared(acd, numConts, nxRed, nyRed, sizeScale, xCenters, yCenters, scaleFac, \
+  minScale, outlieCrit) \
+  private(ind, sum, sumsq, nsum, avg, sd, ixSum, iySum, valVec, tmpVec, cont, size, \
+  bbMin, bbMax, ixStart, ixEnd, iyStart, iyEnd, ix, iy, tpt, xbase, val, fracLow, \
+  numBelow)
   for (ind = 0; ind < numConts; ind++) {
     sum = 0.;
     sumsq = 0.;
@@ -1716,7 +1746,6 @@ void CAutoContouringDlg::SquareStatistics(AutoContData *acd, int nxRed, int nyRe
     iySum = 0;
     valVec.clear();
     cont = &acd->obj->cont[ind];
-    ACCUM_MAX(maxSize, cont->psize);
     size = sqrtf(imodContourArea(cont));
     acd->sqrSizes[ind] = size * sizeScale;
     /*perim = imodContourLength(cont, 1);
@@ -1792,18 +1821,23 @@ void CAutoContouringDlg::SquareStatistics(AutoContData *acd, int nxRed, int nyRe
     cosAng = (float)cos(DTOR * avgAngle);
     sinAng = (float)sin(DTOR * avgAngle);
 
-    // Get a contour and allocated points for rotated, scaled contours
-    rotCont = imodContourNew();
-    if (rotCont) {
-      rotCont->pts = B3DMALLOC(Ipoint, maxSize);
-      if (!rotCont->pts) {
-        imodContourDelete(rotCont);
-        rotCont = NULL;
+    // Do contours in parallel, each with its own contour and points for the rotated,
+    // scaled contour; the squareness stays 0 if these cannot be allocated
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic) \
+  shared(acd, numConts, sizeScale, minForScan, xCenters, yCenters, cosAng, sinAng) \
+  private(ind, cont, rotCont, scanCont, half, scaleForScan, ix, delx, dely, area, \
+  left, right)
+    for (ind = 0; ind < numConts; ind++) {
+      cont = &acd->obj->cont[ind];
+      rotCont = imodContourNew();
+      if (rotCont) {
+        rotCont->pts = B3DMALLOC(Ipoint, cont->psize);
+        if (!rotCont->pts) {
+          imodContourDelete(rotCont);
+          rotCont = NULL;
+        }
       }
-    }
-    if (rotCont) {
-      for (ind = 0; ind < numConts; ind++) {
-        cont = &acd->obj->cont[ind];
+      if (rotCont) {
 
         // Set up equivalent box, determine how much to scale for good area measures
         half = 0.5f * acd->sqrSizes[ind] / sizeScale;
@@ -1859,8 +1893,8 @@ void CAutoContouringDlg::SquareStatistics(AutoContData *acd, int nxRed, int nyRe
 
         // Divide by area of scaled square
         acd->squareness[ind] = area / (4.f * half * half);
+        imodContourDelete(rotCont);
       }
-      imodContourDelete(rotCont);
     }
 
     FindDistancesFromHull(xCenters, yCenters, xBound, yBound, sizeScale, acd->boundDists);
@@ -1987,7 +2021,7 @@ int CAutoContouringDlg::FindDistancesFromHull(FloatVec &xCenters, FloatVec &yCen
   float xcen, ycen;
   Ipoint tpt;
   Icont *cont;
-  int numBelow, ind, ix;
+  int numBelow, ind, ix, numThreads;
 
   // Get convex boundary of centers
   if (useBound)
@@ -2010,6 +2044,12 @@ int CAutoContouringDlg::FindDistancesFromHull(FloatVec &xCenters, FloatVec &yCen
     }
 
     // Get distance of each center from boundary
+    numThreads = B3DNINT(numConts / (5. * CONTS_PER_THREAD));
+    B3DCLAMP(numThreads, 1, MAX_AUTO_SLICE_THREADS);
+    numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numConts, xCenters, yCenters, boundDists, sizeScale, cont, useBound) \
+  private(ind, tpt, ix)
     for (ind = 0; ind < numConts; ind++) {
       tpt.x = xCenters[ind];
       tpt.y = yCenters[ind];
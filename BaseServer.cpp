@@ -48,6 +48,10 @@ int CBaseServer::mDebugVal = 1;
 int CBaseServer::mSuperChunkSize = 33620000;
 SOCKET CBaseServer::mHListener[MAX_SOCK_CHAN];
 SOCKET CBaseServer::mHClient[MAX_SOCK_CHAN];
+HANDLE CBaseServer::mShrMemHandle[MAX_SOCK_CHAN];
+char *CBaseServer::mShrMemView[MAX_SOCK_CHAN];
+int CBaseServer::mShrMemSize[MAX_SOCK_CHAN];
+int CBaseServer::mShrMemGeneration[MAX_SOCK_CHAN];
 bool CBaseServer::mProcessingCommand = false;
 
 CBaseServer::CBaseServer()
@@ -64,6 +68,10 @@ CBaseServer::CBaseServer()
     mMessageBuf[i][0] = 0x00;
     mMessageBuf[i][MESS_ERR_BUFF_SIZE] = 0x00;
     mHClient[i] = INVALID_SOCKET;
+    mShrMemHandle[i] = NULL;
+    mShrMemView[i] = NULL;
+    mShrMemSize[i] = 0;
+    mShrMemGeneration[i] = 0;
   }
   mErrorBuf[MESS_ERR_BUFF_SIZE] = 0x00;
 }
@@ -343,9 +351,11 @@ int CBaseServer::ReallocArgsBufIfNeeded(int needSize, int sockInd)
   return 0;
 }
 
-// Close the socket and mark as invalid
+// Close the socket and mark as invalid; shared memory belongs to the connection and is
+// released too
 void CBaseServer::CloseClient(int sockInd)
 {
+  ReleaseSharedMemory(sockInd);
   if (mHClient[sockInd] == INVALID_SOCKET)
     return;
   _snprintf(mMessageBuf[sockInd], MESS_ERR_BUFF_SIZE,
@@ -654,6 +664,61 @@ int CBaseServer::ReceiveImage(int sockInd, char *imArray, int numBytes, int numC
   return 0;
 }
 
+// Make sure there is a shared memory region for image transfers of at least the given
+// size.  An existing region big enough is kept; otherwise a new one is made with the
+// next generation number in its name, so the client knows to open the new one.
+// Returns 1 on failure, with no region active
+int CBaseServer::SetupSharedMemory(int sockInd, int numBytes)
+{
+  char name[80];
+  __int64 newSize;
+  if (mShrMemView[sockInd] && mShrMemSize[sockInd] >= numBytes)
+    return 0;
+  ReleaseSharedMemory(sockInd);
+  if (numBytes <= 0)
+    return 1;
+
+  // Round up in 64 bits; the size is returned to the client as an int so it cannot
+  // exceed that
+  newSize = (((__int64)numBytes + SOCK_SHR_MEM_ROUNDING - 1) / SOCK_SHR_MEM_ROUNDING) *
+    SOCK_SHR_MEM_ROUNDING;
+  if (newSize > INT_MAX)
+    newSize = INT_MAX;
+  mShrMemGeneration[sockInd]++;
+  _snprintf(name, 79, SOCK_SHR_MEM_PREFIX "%u_%d_%d", GetCurrentProcessId(),
+    (int)mPort[sockInd], mShrMemGeneration[sockInd]);
+  name[79] = 0x00;
+  mShrMemHandle[sockInd] = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+    (DWORD)(newSize >> 32), (DWORD)(newSize & 0xFFFFFFFF), name);
+  if (mShrMemHandle[sockInd])
+    mShrMemView[sockInd] = (char *)MapViewOfFile(mShrMemHandle[sockInd],
+      FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)newSize);
+  if (!mShrMemView[sockInd]) {
+    _snprintf(mMessageBuf[sockInd], MESS_ERR_BUFF_SIZE, "Error %d creating shared "
+      "memory %s of size %d", GetLastError(), name, (int)newSize);
+    ErrorToLog(mMessageBuf[sockInd]);
+    ReleaseSharedMemory(sockInd);
+    return 1;
+  }
+  mShrMemSize[sockInd] = (int)newSize;
+  _snprintf(mMessageBuf[sockInd], MESS_ERR_BUFF_SIZE, "Created shared memory %s of size"
+    " %d", name, (int)newSize);
+  DebugToLog(mMessageBuf[sockInd]);
+  return 0;
+}
+
+// Unmap and close the shared memory region if any
+void CBaseServer::ReleaseSharedMemory(int sockInd)
+{
+  if (mShrMemView[sockInd])
+    UnmapViewOfFile(mShrMemView[sockInd]);
+  if (mShrMemHandle[sockInd])
+    CloseHandle(mShrMemHandle[sockInd]);
+  mShrMemView[sockInd] = NULL;
+  mShrMemHandle[sockInd] = NULL;
+  mShrMemSize[sockInd] = 0;
+}
+
 // Finish getting full message into the buffer
 int CBaseServer::FinishGettingBuffer(int sockInd, char *buffer, int numReceived,
   int numExpected, int bufSize)
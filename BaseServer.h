@@ -16,6 +16,11 @@ enum { REGULAR_PYSOCK_IND = 0, EXTERNAL_PYSOCK_IND, BKGD_PYSOCK_IND};
 #define ARGS_BUFFER_CHUNK 1024
 #define SELECT_TIMEOUT 50
 
+// Shared memory for image transfers is named with this prefix followed by
+// <process ID>_<port>_<generation>, and sized in multiples of the rounding unit
+#define SOCK_SHR_MEM_PREFIX "Local\\SerialEMSockImage_"
+#define SOCK_SHR_MEM_ROUNDING (1024 * 1024)
+
 // This lists the actual arguments in and out, excluding function code in recv and
 // return value on send
 struct ArgDescriptor {
@@ -68,6 +73,11 @@ class CBaseServer
   static SOCKET mHListener[MAX_SOCK_CHAN];
   static SOCKET mHClient[MAX_SOCK_CHAN]; 
 
+  static HANDLE mShrMemHandle[MAX_SOCK_CHAN];   // Per-connection image shared memory
+  static char *mShrMemView[MAX_SOCK_CHAN];
+  static int mShrMemSize[MAX_SOCK_CHAN];
+  static int mShrMemGeneration[MAX_SOCK_CHAN];
+
  public:
    static int GetDebugVal() { return mDebugVal; };
    static void ErrorToLog(const char *message);
@@ -95,6 +105,9 @@ class CBaseServer
   static int FinishGettingBuffer(int sockInd, char *buffer, int numReceived,
     int numExpected, int bufSize);
   static int PackDataToSend(int sockInd);
+  static int SetupSharedMemory(int sockInd, int numBytes);
+  static void ReleaseSharedMemory(int sockInd);
+  static bool SharedMemoryActive(int sockInd) { return mShrMemView[sockInd] != NULL; };
   static int PrepareCommand(int sockInd, int numBytes, ArgDescriptor *funcTable, 
     const char *upgradeMess, int &ind);
   static int FinishGettingBuffer(int numReceived, int numExpected)
@@ -9181,6 +9181,7 @@ UINT CCameraController::AcquireProc(LPVOID pParam)
       _T("Blanking/post action thread did not end properly after the exposure"));
   }
   CoUninitialize();
+  SEMSignalTaskDone();
   return retval;
 }
 
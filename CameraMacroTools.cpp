@@ -494,6 +494,12 @@ void CCameraMacroTools::OnButstop()
     mWinApp->mBufferManager->DoingSychroThread()) {
     mDeferredUserStop = true;
     mWinApp->SetStatusText(MEDIUM_PANE, "STOPPING...");
+  } else if (mWinApp->mMultiGridTasks->GetLoadingAllMaps() ||
+    (nav && nav->GetLoadingNavFile())) {
+    mWinApp->mMultiGridTasks->SetStopLoadingMaps(true);
+    if (nav && nav->GetLoadingNavFile())
+      nav->SetStopLoadingNav(true);
+    mWinApp->SetStatusText(MEDIUM_PANE, "STOPPING...");
   } else {
     DoUserStop();
   }
@@ -73,6 +73,7 @@ EMbufferManager::EMbufferManager(CString *inModeNamep, EMimageBuffer *inImBufs)
   mBufferAsyncFailed = false;
   mSynchronousThread = NULL;
   mNextSecToRead = NO_SUPPLIED_SECTION;
+  mNextReadBinning = 1;
   mHdfUpdateTimePerSect = 0.05f;
   AdocRetryWriteOpens(5);
 }
@@ -717,6 +718,8 @@ int EMbufferManager::ReadFromFile(KImageStore *inStore, int inSect, int inToBuf,
   const char *title, *binStr;
   char titleCopy[84];
   int montErr = 0;
+  int readBin = mNextReadBinning;
+  mNextReadBinning = 1;
   if (message)
     *message = "";
 
@@ -825,7 +828,17 @@ int EMbufferManager::ReadFromFile(KImageStore *inStore, int inSect, int inToBuf,
   inStore->setSection(number);
   toBuf->DeleteImage();
   toBuf->DeleteOffsets();
-  toBuf->mImage = inStore->getRect();
+
+  // Read only the needed pixels when binning, falling back to a full read if the store
+  // cannot do that
+  toBuf->mImage = NULL;
+  if (readBin > 1 && !readPiece && montErr <= 0)
+    toBuf->mImage = inStore->getBinnedRect(0, inStore->getWidth() - 1, 0,
+      inStore->getHeight() - 1, readBin);
+  if (!toBuf->mImage) {
+    readBin = 1;
+    toBuf->mImage = inStore->getRect();
+  }
   if (toBuf->mImage == NULL) {
     if (message)
       *message = "Error reading from file.";
@@ -898,6 +911,7 @@ int EMbufferManager::ReadFromFile(KImageStore *inStore, int inSect, int inToBuf,
   }
   if (!toBuf->mPixelSize && inStore->HasPixelSpacing())
     toBuf->mPixelSize = inStore->GetPixelSpacing() / 10000.f;
+  toBuf->mPixelSize *= readBin;
 
   if (mWinApp->mNavigator)
     toBuf->mRegistration = mWinApp->mNavigator->GetCurrentRegistration();
@@ -934,7 +948,7 @@ int EMbufferManager::ReadFromFile(KImageStore *inStore, int inSect, int inToBuf,
     toBuf->mCamera = mWinApp->GetCurrentCamera();
   CameraParameters *camParam = mWinApp->GetCamParams();
   toBuf->mDivideBinToShow = BinDivisorI(&camParam[toBuf->mCamera]);
-  toBuf->mBinning = B3DNINT(bufBin * toBuf->mDivideBinToShow);
+  toBuf->mBinning = B3DNINT(bufBin * readBin * toBuf->mDivideBinToShow);
 
   // If that fails to get a binning, fall back to the problematic old logic
   if (!toBuf->mBinning) {
@@ -1305,6 +1319,9 @@ UINT EMbufferManager::SavingProc(LPVOID pParam)
   SaveThreadData *saveTD = (SaveThreadData *)pParam;
   KStoreIMOD *istore;
   static int numTimes = 0;
+  const char *typeNames[] = {"MRC", "TIFF/JPEG", "TIFF", "MRC", "JPEG", "HDF", "MRC"};
+  double elapsed, megabytes, startTime = wallTime();
+  int storeType;
   if ((((CSerialEMApp *)AfxGetApp())->GetDebugKeys()).Find('}') >= 0) {
     numTimes++;
     if (numTimes == 8)
@@ -1337,6 +1354,22 @@ UINT EMbufferManager::SavingProc(LPVOID pParam)
   }
   if (!saveTD->error)
     saveTD->store->Flush();
+
+  // Report throughput to allow comparison between file types and compressions
+  if (!saveTD->error && GetDebugOutput('y')) {
+    elapsed = B3DMAX(1.e-6, wallTime() - startTime);
+    storeType = saveTD->store->getStoreType();
+    megabytes = (double)saveTD->store->getWidth() * saveTD->store->getHeight() *
+      KImageStore::lookupPixSize(saveTD->store->getMode()) / 1.e6;
+    SEMTrace('y', "Saved %.1f MB to %s file%s in %.3f sec: %.0f MB/sec", megabytes,
+      storeType >= 0 && storeType <= STORE_TYPE_IIMRC ? typeNames[storeType] : "",
+      ((storeType <= STORE_TYPE_TIFF && storeType != STORE_TYPE_MRC &&
+        saveTD->store->GetCompression() != COMPRESS_NONE)
+      || (storeType == STORE_TYPE_HDF &&
+        saveTD->store->GetHdfCompression() == COMPRESS_ZIP)) ? " with compression" : "",
+      elapsed, megabytes / elapsed);
+  }
+  SEMSignalTaskDone();
   return saveTD->error;
 }
 
@@ -69,6 +69,7 @@ public :
   GetMember(bool, ImageAsyncFailed);
   GetMember(bool, BufferAsyncFailed);
   SetMember(int, NextSecToRead);
+  SetMember(int, NextReadBinning);
   GetMember(int, AsyncTimeout);
   GetMember(BOOL, DoingAsyncSave);
   bool DoingSychroThread() {return mSynchronousThread != NULL; };
@@ -109,6 +110,7 @@ public :
   bool mImageAsyncFailed;
   bool mBufferAsyncFailed;
   int mNextSecToRead;
+  int mNextReadBinning;        // Binning to apply in the next read of a single section
   float mHdfUpdateTimePerSect;  // Maximum time per section to spend updating HDF header
 
 public:
@@ -123,6 +123,19 @@ static float sStageErrWaitFactor = 9.;      // Wait for this # sec divided by sp
 static HANDLE sMagMutexHandle;
 static HANDLE sDataMutexHandle;
 
+// Cache of scope state values read by the update or getters on Thermo/FEI-like scopes.
+// Each value has the tick time when read, or -1 if invalid, and a maximum age in msec
+// that is short for values that change during acquisition and long for slow optics
+struct ScopeCacheEntry {
+  double value;
+  double time;
+  int maxAge;
+};
+static ScopeCacheEntry sStateCache[SCACHE_NUM_VALUES] = {{0., -1., 100}, {0., -1., 100},
+  {0., -1., 1000}, {0., -1., 1000}, {0., -1., 200}};
+static HANDLE sCacheMutexHandle = NULL;
+static int sNumCacheHits = 0, sNumCacheReads = 0;
+
 // Simulation values
 static int sSimLoadedCartridge = -1;
 static int sSimApertureSize[MAX_APERTURE_NUM + 1] = {0,0,0,0,0,0,0,0,0,0,0, 0};
@@ -156,6 +169,7 @@ BOOL   CEMscope::mBeamBlanked = false;
 char * CEMscope::mFEIInstrumentName;
 ScopePluginFuncs *CEMscope::mPlugFuncs;
 int CEMscope::mScopeCallFromPlugin = 0;
+float CEMscope::mCacheAgeFactor = 1.;
 
 #define VAR_BOOL(a) ((a) ? *vTrue : *vFalse)
 
@@ -390,6 +404,8 @@ CEMscope::CEMscope()
   // General initializations (-1 for these 2 that are scope-dependent)
   mHasNoAlpha = -1;
   mUpdateInterval = -1;
+  if (!sCacheMutexHandle)
+    sCacheMutexHandle = CreateMutex(0, 0, 0);
   mMagFixISdelay = 450;    // Was 300: needed to be longer for diffraction
   mJeolForceMDSmode = 0;
   mCalNeutralStartMag = -1;
@@ -660,7 +676,7 @@ int CEMscope::Initialize()
   mPlugFuncs = mWinApp->mPluginManager->GetScopeFuncs();
   if (message == "HitachiScope") {
     HitachiScope = true;
-  } else if (message == "FEIScope") {
+  } else if (message == "FEIScope" || message == "SimulatedScope") {
     if (!mPlugFuncs->BeginThreadAccess) {
       AfxMessageBox("An FEI scope plugin was loaded but it is too old\n"
         "to use with this version of SerialEM", MB_EXCLAME);
@@ -1910,6 +1926,7 @@ void CEMscope::ScopeUpdate(DWORD dwTime)
         mLastFocusInUpdate != mFirstFocusForProbe) {
         defocus += mLastFocusInUpdate - mFirstFocusForProbe;
         PLUGSCOPE_SET(Defocus, defocus * 1.e-6);
+        InvalidateStateCache();
       }
       mFirstFocusForProbe = defocus;
       if (FEIscope)
@@ -2152,6 +2169,7 @@ void CEMscope::UpdateScreenBeamFocus(int STEMmode, int &screenPos, int &smallScr
                                      int &spotSize, double &rawIntensity, double &current,
                                      double &defocus, double &objective, float &alpha)
 {
+  double cached;
   if (JEOLscope) {
     screenPos = spJeolToFEI[mJeolSD.screenPos];
     rawIntensity = mJeolSD.rawIntensity;
@@ -2168,8 +2186,16 @@ void CEMscope::UpdateScreenBeamFocus(int STEMmode, int &screenPos, int &smallScr
     } else {
       PLUGSCOPE_GET(Intensity, rawIntensity, 1.);
       rawIntensity += mAddToRawIntensity;
+      SetCachedValue(SCACHE_INTENSITY, rawIntensity);
+    }
+
+    // Spot size changes rarely, so read it only when the cached value is old
+    if (GetCachedValue(SCACHE_SPOT_SIZE, cached, true)) {
+      spotSize = B3DNINT(cached);
+    } else {
+      PLUGSCOPE_GET(SpotSize, spotSize, 1);
+      SetCachedValue(SCACHE_SPOT_SIZE, spotSize);
     }
-    PLUGSCOPE_GET(SpotSize, spotSize, 1);
     // TEMP FOR BAD VM!
     if (!sCheckPosOnScreenError)
       PLUGSCOPE_GET(ScreenCurrent, current, 1.e9);
@@ -2178,10 +2204,18 @@ void CEMscope::UpdateScreenBeamFocus(int STEMmode, int &screenPos, int &smallScr
   if (smallScreen)
     current *= mSmallScreenFactor;
   current *= mScreenCurrentFactor;
+  if (!JEOLscope && !sCheckPosOnScreenError)
+    SetCachedValue(SCACHE_SCREEN_CURRENT, current);
 
-  // Get the defocus and objective excitation
+  // Get the defocus and objective excitation, the latter only when it is old
   PLUGSCOPE_GET(Defocus, defocus, 1.e6);
-  PLUGSCOPE_GET(ObjectiveStrength, objective, 100.);
+  SetCachedValue(SCACHE_DEFOCUS, defocus);
+  if (GetCachedValue(SCACHE_OBJECTIVE, cached, true)) {
+    objective = 100. * cached;
+  } else {
+    PLUGSCOPE_GET(ObjectiveStrength, objective, 100.);
+    SetCachedValue(SCACHE_OBJECTIVE, objective / 100.);
+  }
 }
 
 // Determine vacuum status for gauges for FEI
@@ -2812,6 +2846,7 @@ UINT CEMscope::StageMoveProc(LPVOID pParam)
   }
   CoUninitialize();
   ScopeMutexRelease("StageMoveProc");
+  SEMSignalTaskDone();
   return retval;
 }
 
@@ -3839,6 +3874,8 @@ double CEMscope::GetScreenCurrent()
 
   if (!sInitialized)
     return 0.;
+  if (GetCachedValue(SCACHE_SCREEN_CURRENT, result))
+    return result;
 
   ScopeMutexAcquire("GetScreenCurrent",true);
 
@@ -3847,6 +3884,7 @@ double CEMscope::GetScreenCurrent()
     result *= mScreenCurrentFactor;
     if (SmallScreenIn())
       result *= mSmallScreenFactor;
+    SetCachedValue(SCACHE_SCREEN_CURRENT, result);
   }
   catch (_com_error E) {
     SEMReportCOMError(E, _T("getting screen current "));
@@ -4060,6 +4098,7 @@ UINT CEMscope::ScreenMoveProc(LPVOID pParam)
   if (!retval && info->finishedTick > 0)
     Sleep(info->finishedTick);
   CoUninitialize();
+  InvalidateStateCache();
   ScopeMutexRelease("ScreenMoveProc");
   return retval;
 }
@@ -4101,6 +4140,7 @@ BOOL CEMscope::SetFilamentCurrent(double current)
     SEMReportCOMError(E, _T("setting filament current "));
     success = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetFilamentCurrent");
   return success;
 }
@@ -4135,6 +4175,7 @@ BOOL CEMscope::SetEmissionState(int state)
   catch (_com_error E) {
     SEMReportCOMError(E, _T("setting FEG emission state "));
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetEmissionState");
   return success;
 }
@@ -4622,6 +4663,7 @@ bool CEMscope::SetSTEMMagnification(double magVal)
     SEMReportCOMError(E, _T("setting STEM magnification "));
     success = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetSTEMMagnification");
   return success;
 
@@ -5079,6 +5121,7 @@ BOOL CEMscope::SetCamLenIndex(int inIndex)
   // Keep update from operating on the change
   SetMagChanged(0);
   HandleNewMag(0);
+  InvalidateStateCache();
   ScopeMutexRelease("SetCamLenIndex");
   return result;
 }
@@ -5257,7 +5300,7 @@ BOOL CEMscope::NormalizeProjector()
     SEMReportCOMError(E, _T("normalizing projection lenses "));
     result = false;
   }
-
+  InvalidateStateCache();
   ScopeMutexRelease(routine);
   return result;
 }
@@ -5286,6 +5329,7 @@ BOOL CEMscope::NormalizeCondenser()
     SEMReportCOMError(E, _T("normalizing condenser lenses "));
     success = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease(routine);
   return success;
 }
@@ -5314,6 +5358,7 @@ BOOL CEMscope::NormalizeObjective()
     SEMReportCOMError(E, _T("normalizing Objective lens "));
     success = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease(routine);
   return success;
 }
@@ -5394,12 +5439,15 @@ double CEMscope::GetDefocus()
 
   // 11/30/10: There is no focus value by event! Eliminate forceread, use of stored value
   // Plugin recomputes it when getting fast
+  if (GetCachedValue(SCACHE_DEFOCUS, result))
+    return result;
   bool needMutex = !(JEOLscope && sGettingValuesFast);
   if (needMutex)
     ScopeMutexAcquire("GetDefocus", true);
 
   try {
     PLUGSCOPE_GET(Defocus, result, 1.e6);
+    SetCachedValue(SCACHE_DEFOCUS, result);
   }
   catch (_com_error E) {
     SEMReportCOMError(E, _T("getting defocus "));
@@ -5438,6 +5486,7 @@ BOOL CEMscope::SetDefocus(double inVal, BOOL incremental)
     SEMReportCOMError(E, _T("setting defocus "));
     success = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetDefocus");
   return success;
 }
@@ -5494,9 +5543,12 @@ double CEMscope::GetObjectiveStrength(void)
   if (!sInitialized)
     return 0.;
 
+  if (GetCachedValue(SCACHE_OBJECTIVE, result))
+    return result;
   ScopeMutexAcquire("GetObjectiveStrength", true);
   try {
     PLUGSCOPE_GET(ObjectiveStrength, result, 1.);
+    SetCachedValue(SCACHE_OBJECTIVE, result);
   }
   catch (_com_error E) {
     SEMReportCOMError(E, _T("getting objective strength "));
@@ -5547,6 +5599,7 @@ BOOL CEMscope::SetFocus(double inVal)
     SEMReportCOMError(E, _T("setting focus "));
     success = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetFocus");
   return success;
 }
@@ -5567,6 +5620,7 @@ BOOL CEMscope::SetObjFocus(int step)
     SEMReportCOMError(E, _T("setting objective focus "));
     success = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetObjFocus");
   return success;
 }
@@ -6657,6 +6711,7 @@ BOOL CEMscope::SetIntensityZoom(BOOL inVal)
     SEMReportCOMError(E, _T("setting state of Intensity Zoom "));
     result = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetIntensityZoom");
   return result;
 }
@@ -6676,6 +6731,8 @@ double CEMscope::GetIntensity()
   }
 
   //Plugin  uses state value if getting fast
+  if (GetCachedValue(SCACHE_INTENSITY, result))
+    return result;
   bool needMutex = !(JEOLscope && sGettingValuesFast);
   if (needMutex)
     ScopeMutexAcquire("GetIntensity", true);
@@ -6683,6 +6740,7 @@ double CEMscope::GetIntensity()
   try {
     PLUGSCOPE_GET(Intensity, result, 1.);
     result += mAddToRawIntensity;
+    SetCachedValue(SCACHE_INTENSITY, result);
   }
   catch (_com_error E) {
     SEMReportCOMError(E, _T("getting beam intensity "));
@@ -6730,6 +6788,7 @@ BOOL CEMscope::SetIntensity(double inVal, int spot, int probe)
     SEMReportCOMError(E, _T("setting beam intensity "));
     result = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetIntensity");
   return result;
 }
@@ -6829,6 +6888,7 @@ BOOL CEMscope::SetIlluminatedArea(double inVal)
     return false;
   try {
     PLUGSCOPE_SET(IlluminatedArea, 1.e-4 * inVal);
+    InvalidateStateCache();
     result = true;
   }
   catch (_com_error E) {
@@ -6921,6 +6981,7 @@ BOOL CEMscope::SetImageDistanceOffset(double inVal)
     SEMReportCOMError(E, _T("setting image distance offset "));
     result = false;
   }
+  InvalidateStateCache();
   return result;
 }
 
@@ -6944,11 +7005,14 @@ double CEMscope::GetConvergenceAngle()
 int CEMscope::GetSpotSize()
 {
   int result;
+  double cached;
 
   if (!sInitialized)
     return 0;
 
   // Plugin will use state value if update by event, getting fast, or Jeol 1230
+  if (GetCachedValue(SCACHE_SPOT_SIZE, cached))
+    return B3DNINT(cached);
   bool needMutex = !(JEOLscope && (mJeolSD.eventDataIsGood || mJeol1230 ||
     sGettingValuesFast));
   if (needMutex)
@@ -6956,6 +7020,7 @@ int CEMscope::GetSpotSize()
 
   try {
     PLUGSCOPE_GET(SpotSize, result, 1);
+    SetCachedValue(SCACHE_SPOT_SIZE, result);
   }
   catch (_com_error E) {
     SEMReportCOMError(E, _T("getting spot size "));
@@ -7255,6 +7320,7 @@ BOOL CEMscope::SetLensByName(CString & name, double value)
     SEMReportCOMError(E, _T("setting lens by name "));
     result = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetLensByName");
   return result;
 }
@@ -7335,6 +7401,7 @@ BOOL CEMscope::SetLensWithFLC(int lens, double inVal, bool relative, int reportE
         "lens control", lens, inVal);
     result = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetLensWithFLC");
   return result;
 }
@@ -7434,6 +7501,7 @@ BOOL CEMscope::SetColumnValvesOpen(BOOL state, bool crashing)
       SEMReportCOMError(E, _T("setting column valves "));
     result = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetBeamValve");
   if (mOpenValvesDelay && state)
     mShiftManager->SetGeneralTimeOut(GetTickCount(), mOpenValvesDelay);
@@ -7549,6 +7617,7 @@ bool CEMscope::SetHTValue(double inVal)
     result = false;
     SEMReportCOMError(E, _T("setting the high voltage "));
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetHTValue");
   return result;
 }
@@ -8745,6 +8814,7 @@ bool CEMscope::SetSTEM(BOOL inState)
     if (mode != curMode) {
       mPlugFuncs->SetSTEMMode(inState);
     }
+    InvalidateStateCache();
     ScopeMutexRelease("SetSTEM");
     if (JEOLscope && !mWinApp->GetStartingProgram()) {
       SuspendUpdate(jeolSleep);
@@ -8950,6 +9020,7 @@ BOOL CEMscope::SetEFTEM(BOOL inState)
     SEMReportCOMError(E, _T("setting lens program "));
     result = false;
   }
+  InvalidateStateCache();
   ScopeMutexRelease("SetEFTEM");
   return result;
 }
@@ -11332,6 +11403,7 @@ BOOL CEMscope::RunSynchronousThread(int action, int newIndex, int curIndex,
   mSynchroTD.HitachiSpotBeamWait = mHitachiSpotBeamWait;
   mSynchroTD.HitachiSpotStepDelay = mHitachiSpotStepDelay;
 
+  InvalidateStateCache();
   startTime = GetTickCount();
   while (StageBusy() && SEMTickInterval(startTime) < 10000) {
     mWinApp->ManageBlinkingPane(GetTickCount());
@@ -11361,7 +11433,8 @@ BOOL CEMscope::RunSynchronousThread(int action, int newIndex, int curIndex,
     SleepMsg(20);
   }
 
-  // Restore windows
+  // Restore windows; values changed by the operation are no longer valid
+  InvalidateStateCache();
   if (!mChangingLDArea) {
     mWinApp->UpdateBufferWindows();
     mWinApp->SetStatusText(SIMPLE_PANE, "");
@@ -11377,6 +11450,54 @@ BOOL CEMscope::RunSynchronousThread(int action, int newIndex, int curIndex,
   return retval == 0;
 }
 
+// Return a value from the state cache if it is valid and not older than its maximum age
+// scaled by the age factor; the update passes forUpdate to count only outside reads
+bool CEMscope::GetCachedValue(int which, double &value, bool forUpdate)
+{
+  bool fresh;
+  if (JEOLscope || mCacheAgeFactor <= 0. || !sCacheMutexHandle)
+    return false;
+  WaitForSingleObject(sCacheMutexHandle, INFINITE);
+  fresh = sStateCache[which].time >= 0. && SEMTickInterval(sStateCache[which].time) <=
+    mCacheAgeFactor * sStateCache[which].maxAge;
+  if (fresh)
+    value = sStateCache[which].value;
+  if (!forUpdate) {
+    sNumCacheReads++;
+    if (fresh)
+      sNumCacheHits++;
+    if (sNumCacheReads >= 1000) {
+      SEMTrace('u', "Scope state cache served %d of %d reads", sNumCacheHits,
+        sNumCacheReads);
+      sNumCacheReads = sNumCacheHits = 0;
+    }
+  }
+  ReleaseMutex(sCacheMutexHandle);
+  return fresh;
+}
+
+// Store a value just read from the scope with the current time
+void CEMscope::SetCachedValue(int which, double value)
+{
+  if (JEOLscope || !sCacheMutexHandle)
+    return;
+  WaitForSingleObject(sCacheMutexHandle, INFINITE);
+  sStateCache[which].value = value;
+  sStateCache[which].time = GetTickCount();
+  ReleaseMutex(sCacheMutexHandle);
+}
+
+// Mark all values as invalid; to be called whenever SerialEM changes optical state
+void CEMscope::InvalidateStateCache()
+{
+  if (!sCacheMutexHandle)
+    return;
+  WaitForSingleObject(sCacheMutexHandle, INFINITE);
+  for (int ind = 0; ind < SCACHE_NUM_VALUES; ind++)
+    sStateCache[ind].time = -1.;
+  ReleaseMutex(sCacheMutexHandle);
+}
+
 // The thread procedure for synchronous threads
 // Get mutex, set up to do operations in thread, and dispatch to proper function
 UINT CEMscope::SynchronousProc(LPVOID pParam)
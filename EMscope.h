@@ -45,6 +45,11 @@ enum {RefrigerantLevel_AutoloaderDewar = 0,
     RefrigerantLevel_ColumnDewar, RefrigerantLevel_HeliumDewar};
 enum { JAL_STATION_UNKNOWN = 0, JAL_STATION_MAGAZINE, JAL_STATION_STORAGE, JAL_STATION_STAGE };
 enum {gsUnderflow = 1, gsOverflow, gsInvalid};
+
+// Values kept in the cache of scope state for Thermo/FEI-like scopes
+enum {SCACHE_DEFOCUS = 0, SCACHE_INTENSITY, SCACHE_SPOT_SIZE, SCACHE_OBJECTIVE,
+  SCACHE_SCREEN_CURRENT, SCACHE_NUM_VALUES};
+
 enum {imNanoProbe = 0, imMicroProbe};
 #define pmDiffraction 2
 #define pmImaging 1
@@ -676,6 +681,11 @@ public:
 
   static BOOL ScopeMutexAcquire(const char *name, BOOL retry);
   static BOOL ScopeMutexRelease(const char *name);
+  static bool GetCachedValue(int which, double &value, bool forUpdate = false);
+  static void SetCachedValue(int which, double value);
+  static void InvalidateStateCache();
+  static float GetCacheAgeFactor() { return mCacheAgeFactor; };
+  static void SetCacheAgeFactor(float inVal) { mCacheAgeFactor = inVal; };
   static int BeginFEIThreadAccess(ScopePluginFuncs *plugFuncs, int chan, int make);
   static void EndFEIThreadAccess(ScopePluginFuncs *plugFuncs, int chan);
   static float ConvertJEOLStage(double inMove, float &outRem);
@@ -1077,6 +1087,7 @@ private:
   int mFLCInLMGenDelay;        // General sleep time (ms) after setting FLC state or value
   int mFLCInLMAcqDelay;        // Sleep time (ms) after turning off FLC for acquisition
   int mScopeUpdateTaskSkips;   // # of times to skip scope update when task is running
+  static float mCacheAgeFactor;  // Factor for maximum ages of cached values, 0 to disable
   int mJeolUpdateTaskSkips;    // # of times to skip an update from JEOL scope in thread
   bool mSkipUpdatesForTasks;   // Flag to do the skipping
   int mMaxUtapiService;        // Maximum UTAPI service # in plugin from array of names
@@ -27,6 +27,7 @@
 #include "EMmontageController.h"
 #include "AutoTuning.h"
 #include "Utilities\STEMfocus.h"
+#include "Shared\b3dutil.h"
 
 #if defined(_DEBUG) && defined(_CRTDBG_MAP_ALLOC)
 #define new DEBUG_NEW
@@ -116,6 +117,7 @@ CFocusManager::CFocusManager()
   mFCindex = -1;
   for (int k = 0; k < 5; k++)
     mFocusBuf[k] = NULL;
+  mPrepOverlapTime = 0.;
   mScope = NULL;
 
   mCurrentDefocus = 0.;
@@ -1442,6 +1444,7 @@ void CFocusManager::DetectFocus(int inWhere, int useViewInLD)
   mNumShots = (mTripleMode || (inWhere == FOCUS_CALIBRATE || inWhere == FOCUS_CAL_ASTIG ||
     inWhere == FOCUS_COMA_FREE)) ? 3 : 2;
   mFocusIndex = 0;
+  mPrepOverlapTime = 0.;
   mLastFailed = true;
   mLastAborted = 0;
   mCamera->SetObeyTiltDelay(true);
@@ -1540,31 +1543,19 @@ void CFocusManager::TaskFocusError(int error)
 // Process image when a focus image is done
 void CFocusManager::FocusDone()
 {
-  int nxframe, nyframe, nxuse, nyuse, nxpad, nypad, type;
-  int  ix0, ix1, iy0, iy1, ind1, ind2;
-  KImage *imA;
-  void *data, *temp;
-  float *cArray = NULL;
+  int nxpad, nypad, nxuse, nyuse, ix0, ind1, ind2, index;
   float xPeak1[2], yPeak1[2], xPeak2[2], yPeak2[2], peak1[2], peak2[2];
-  float xShift, yShift, xDrift, yDrift, interval;
+  float xShift, yShift, xDrift, yDrift;
+  float *cArray = NULL;
   CString report;
-  int trim =4;   // 3/19/06: set to 4 from 0 for Ultracam with bad lines
-  int pad, minBinning, needBin = 1;
+  int needBin = 1;
   float radius2use = mRadius2;
   float sigma2use = mSigma2;
-  int nxTaper, nyTaper;
   float delta, tiltA, tiltAngles[2] = {0., 0.}, axisAngle = 0.;
-  void *stretchData = NULL;
-  BOOL doStretch;
-  bool removeData = false;
   BOOL erasePeaks = mShiftManager->GetErasePeriodicPeaks();
-  double imRot, CCC, elapsed;
-  UINT tickTime;
-  float tilt, pixel, cosphi, sinphi, tanTilt, a11, a12, a21, a22;
+  double imRot, CCC, startTime;
   int binning = mConSets[mFocusSetNum].binning;
   int iCam = mWinApp->GetCurrentCamera();
-  FocusTable focCal;
-  int ifCalibrated = GetFocusCal(mFocusMag, iCam, mFocusProbe, mFocusAlpha, focCal);
   int bufnum = 0;
   CameraParameters *camParam = mWinApp->GetActiveCamParam();
   int divForK2 = BinDivisorI(camParam);
@@ -1581,16 +1572,188 @@ void CFocusManager::FocusDone()
     StopFocusing();
     return;
   }
+  mBufTimeStamp[B3DMIN(2, mFocusIndex)] = mImBufs[bufnum].mTimeStamp;
+  index = mFocusIndex++;
+
+  // If there is another shot to take, start it first so that preparing this image
+  // overlaps with the beam tilt change and the exposure.  The new image does not get
+  // into the buffers until this returns.  Not when showing the stretch in a buffer
+  if (mFocusIndex < mNumShots && !mUsingExisting && mFocusWhere != FOCUS_SHOW_STRETCH) {
+    StartNextFocusShot();
+    startTime = wallTime();
+    if (!PrepareFocusImage(bufnum, index, binning, needBin, nxuse, nyuse, nxpad, nypad,
+      radius2use, sigma2use))
+      mPrepOverlapTime += wallTime() - startTime;
+    return;
+  }
+
+  if (PrepareFocusImage(bufnum, index, binning, needBin, nxuse, nyuse, nxpad, nypad,
+    radius2use, sigma2use))
+    return;
+  if (mFocusIndex < mNumShots) {
+    StartNextFocusShot();
+    return;
+  }
+  if (mPrepOverlapTime > 0.)
+    SEMTrace('1', "Autofocus saved %.0f msec by preparing images during next shot",
+      1000. * mPrepOverlapTime);
+  mPrepOverlapTime = 0.;
+
+  //  All three shots done, get the triple correlation
+  XCorrSetCTF(mSigma1, sigma2use, 0., radius2use, mCTFa, nxpad, nypad, &delta);
+
+  if (erasePeaks) {
+    NewArray2(cArray, float, nypad, (nxpad + 2));
+    if (!cArray)
+      erasePeaks = false;
+    if (mImBufs->GetTiltAngle(tiltA) && mImBufs->GetAxisAngle(axisAngle))
+      tiltAngles[0] = tiltAngles[1] = tiltA;
+  }
+
+  if (mNumShots == 3) {
+    if (erasePeaks) {
+      XCorrPeriodicCorr(mFocusBuf[0], mFocusBuf[1], cArray, nxpad, nypad, delta, mCTFa,
+        tiltAngles, axisAngle, 0, 0.);
+      memcpy(mFocusBuf[1], mFocusBuf[4], 4 * nypad * (nxpad + 2));
+      XCorrPeriodicCorr(mFocusBuf[1], mFocusBuf[2], cArray, nxpad, nypad, delta, mCTFa,
+        tiltAngles, axisAngle, 0, 0.);
+
+    } else {
+      XCorrTripleCorr(mFocusBuf[0], mFocusBuf[1], mFocusBuf[2], nxpad, nypad,
+        delta, mCTFa);
+    }
+
+    XCorrPeakFind(mFocusBuf[0], nxpad+2, nypad, xPeak1, yPeak1, peak1, 2);
+    XCorrPeakFind(mFocusBuf[1], nxpad+2, nypad, xPeak2, yPeak2, peak2, 2);
+    ind1 = CheckZeroPeak(xPeak1, yPeak1, peak1, binning);
+    ind2 = CheckZeroPeak(xPeak2, yPeak2, peak2, -binning);
+
+    // INVERT THOSE Y VALUES to make shifts properly rotatable
+    xShift = binning * (xPeak1[ind1] - xPeak2[ind2]) / 2;
+    yShift = binning * (yPeak2[ind2] - yPeak1[ind1]) / 2;
+    xDrift = binning * (xPeak2[ind2] + xPeak1[ind1]) / 2;
+    yDrift = -binning * (yPeak2[ind2] + yPeak1[ind1]) / 2;
+  } else {
+    if (erasePeaks) {
+      XCorrPeriodicCorr(mFocusBuf[0], mFocusBuf[1], cArray, nxpad, nypad, delta, mCTFa,
+        tiltAngles, axisAngle, 0, 0.);
+    } else {
+      XCorrCrossCorr(mFocusBuf[0], mFocusBuf[1], nxpad, nypad, delta, mCTFa);
+    }
+    XCorrPeakFind(mFocusBuf[0], nxpad+2, nypad, xPeak1, yPeak1, peak1, 2);
+    ind1 = CheckZeroPeak(xPeak1, yPeak1, peak1, binning);
+    xShift =  binning * xPeak1[ind1];
+    yShift = -binning * yPeak1[ind1];
+  }
+  delete [] cArray;
+
+  // Display correlation in buffer A if requested
+  if (mFocusWhere == FOCUS_SHOW_CORR) {
+    float corMin, corMax;
+    mWinApp->mProcessImage->CorrelationToBufferA(mFocusBuf[0], nxpad, nypad, needBin,
+      corMin, corMax);
+    mWinApp->SetCurrentBuffer(0);
+  }
+
+  // Compute unfiltered normalized CCC
+  CCC = XCorrCCCoefficient(mFocusBuf[3], mFocusBuf[4], nxpad + 2, nxpad, nypad,
+    -xPeak1[ind1], -yPeak1[ind1], (nxpad + 1 - nxuse) / 2, (nypad + 1 - nyuse) /2, &ix0);
+
+  for (int ibuf = 0; ibuf < 5; ibuf++) {
+    if (mFocusBuf[ibuf])
+      delete [] mFocusBuf[ibuf];
+    mFocusBuf[ibuf] = NULL;
+  }
+
+  mLastFailed = false;
+  mDriftStored = mNumShots == 3;
+  mRequiredBWMean = -1.;
+  mFocusIndex = -1;
+  mScope->SetBeamTilt(mBaseTiltX, mBaseTiltY);
+  if (mAppliedOffset)
+    mScope->IncDefocus(-mAppliedOffset);
+  mAppliedOffset = 0.;
+
+  // Prepare report and store the drift values
+  CString strBin = binning > divForK2 ? "unbinned" : "";
+  report.Format("Tilt-induced shift is %6.2f, %6.2f %s pixels, unfiltered CCC is %.4f",
+    -xShift / divForK2, -yShift / divForK2, strBin, CCC);
+  if (mNumShots == 3) {
+    CString strTemp;
+    imRot = 1000. * mShiftManager->GetPixelSize(iCam, mFocusMag)
+      / (mBufTimeStamp[2] - mBufTimeStamp[0]);
+    mLastDriftX = -(float)(xDrift * imRot);
+    mLastDriftY = -(float)(yDrift * imRot);
+    mLastNmPerSec = (float)(imRot * sqrt(xDrift * xDrift + yDrift * yDrift));
+    strTemp.Format("\r\nThe average drift between shots was %6.1f, %6.1f %s pixels, "
+      "%.2f nm/sec", xDrift / divForK2, yDrift / divForK2, strBin, mLastNmPerSec);
+    report += strTemp;
+    mLastDriftImageTime = mCamera->GetLastAcquireStartTime();
+  }
+
+  // Temporary report
+//  if (mFocusWhere != FOCUS_REPORT)
+//    mWinApp->AppendToLog(report, LOG_SWALLOW_IF_NOT_ADMIN_OR_OPEN);
+
+  switch (mFocusWhere) {
+    case FOCUS_CALIBRATE:
+      CalFocusData(xShift, yShift);
+      break;
+
+    case FOCUS_AUTOFOCUS:
+      if (mVerbose && !mWinApp->mParticleTasks->GetWaitingForDrift())
+        mWinApp->VerboseAppendToLog(true, report);
+      AutoFocusData(xShift, yShift);
+      break;
+
+    case FOCUS_CAL_ASTIG:
+    case FOCUS_ASTIGMATISM:
+    case FOCUS_COMA_FREE:
+      mWinApp->mAutoTuning->TuningFocusData(xShift, yShift);
+      break;
+
+    case FOCUS_EXISTING:
+    case FOCUS_REPORT:
+    case FOCUS_SHOW_CORR:
+    case FOCUS_SHOW_STRETCH:
+      mWinApp->AppendToLog(report, LOG_MESSAGE_IF_CLOSED);
+      FocusTasksFinished();
+      break;
+  }
+}
+
+// Extract image for the given focus index into a tapered, padded array, binning and
+// stretching it if needed.  Returns 1 after stopping focusing if there is an error
+int CFocusManager::PrepareFocusImage(int bufnum, int index, int &binning, int &needBin,
+  int &nxuse, int &nyuse, int &nxpad, int &nypad, float &radius2use, float &sigma2use)
+{
+  int nxframe, nyframe, type;
+  int  ix0, ix1, iy0, iy1;
+  KImage *imA;
+  void *data, *temp;
+  int trim =4;   // 3/19/06: set to 4 from 0 for Ultracam with bad lines
+  int pad, minBinning;
+  int nxTaper, nyTaper;
+  void *stretchData = NULL;
+  BOOL doStretch;
+  bool removeData = false;
+  double imRot;
+  float tilt, pixel, cosphi, sinphi, tanTilt, a11, a12, a21, a22;
+  int iCam = mWinApp->GetCurrentCamera();
+  FocusTable focCal;
+  int ifCalibrated = GetFocusCal(mFocusMag, iCam, mFocusProbe, mFocusAlpha, focCal);
+  CameraParameters *camParam = mWinApp->GetActiveCamParam();
+  int divForK2 = BinDivisorI(camParam);
 
   // Extract the new image into a tapered, padded array
   imA = mImBufs[bufnum].mImage;
-  mBufTimeStamp[B3DMIN(2, mFocusIndex)] = mImBufs[bufnum].mTimeStamp;
   nxframe = imA->getWidth();
   nyframe = imA->getHeight();
   type = imA->getType();
 
   // See if binning is needed, or at least scaling of filter parameters
   minBinning = mDDDminBinning * BinDivisorI(camParam);
+  needBin = 1;
   if ((mCamera->IsDirectDetector(camParam) || camParam->useMinDDDBinning) &&
     binning > 0 && binning < minBinning) {
 
@@ -1607,7 +1770,7 @@ void CFocusManager::FocusDone()
         SEMMessageBox(_T("Error getting buffer for binning - focus aborted"));
         StopFocusing();
         imA->UnLock();
-        return;
+        return 1;
       }
 
       // Do the binning and replace parameters
@@ -1639,10 +1802,10 @@ void CFocusManager::FocusDone()
   // is a focus calibration available
   if (!mImBufs[bufnum].GetTiltAngle(tilt))
     tilt = (float)mScope->GetTiltAngle();
-  doStretch = (mFocusIndex == 1) && (tilt > 5. || tilt < -5.) && ifCalibrated;
-  NewArray2(mFocusBuf[mFocusIndex], float, nypad, (nxpad + 2));
-  if (mFocusIndex < 2)
-    NewArray2(mFocusBuf[mFocusIndex + 3], float, nypad, (nxpad + 2));
+  doStretch = (index == 1) && (tilt > 5. || tilt < -5.) && ifCalibrated;
+  NewArray2(mFocusBuf[index], float, nypad, (nxpad + 2));
+  if (index < 2)
+    NewArray2(mFocusBuf[index + 3], float, nypad, (nxpad + 2));
   if (doStretch) {
     if (type == kUBYTE) {
       NewArray2(stretchData, unsigned char, nxframe, nyframe);
@@ -1651,15 +1814,15 @@ void CFocusManager::FocusDone()
     }
   }
 
-  if (mFocusBuf[mFocusIndex] == NULL  || (doStretch && stretchData == NULL) ||
-    (mFocusIndex < 2 && mFocusBuf[mFocusIndex + 3] == NULL)) {
+  if (mFocusBuf[index] == NULL  || (doStretch && stretchData == NULL) ||
+    (index < 2 && mFocusBuf[index + 3] == NULL)) {
     SEMMessageBox(_T("Error getting image buffers - focus aborted"), MB_EXCLAME);
     if (stretchData)
       delete [] stretchData;
     if (removeData)
       delete [] data;
     StopFocusing();
-    return;
+    return 1;
   }
 
   if (needBin < 2) {
@@ -1713,163 +1876,46 @@ void CFocusManager::FocusDone()
  }
 
   XCorrTaperInPad(data, type, nxframe, ix0, ix1, iy0, iy1,
-          mFocusBuf[mFocusIndex],
+          mFocusBuf[index],
           nxpad + 2, nxpad, nypad, nxTaper, nyTaper);
   if (removeData)
     delete [] data;
   else
     imA->UnLock();
-  if (mFocusIndex < 2)
-    memcpy(mFocusBuf[mFocusIndex + 3], mFocusBuf[mFocusIndex], 4 * nypad * (nxpad + 2));
-
-  mFocusIndex++;
-  if (mFocusIndex < mNumShots) {
-    int sign = 3 - 2 * mFocusIndex;
-    //PrintfToLog("Set beam tilt to %.2f, %.2f", mBaseTiltX + mNextXtiltOffset + mFracTiltX * sign * mWorkingBT,
-    //  mBaseTiltY + mNextYtiltOffset + mFracTiltY * sign * mWorkingBT);
-    mScope->SetBeamTilt(mBaseTiltX + mNextXtiltOffset + mFracTiltX * sign * mWorkingBT,
-      mBaseTiltY + mNextYtiltOffset + mFracTiltY * sign * mWorkingBT);
-    if (mPostTiltDelay > 0)
-      Sleep(mPostTiltDelay);
-    if (mWinApp->mParticleTasks->GetWaitingForDrift()) {
-      interval = 500.f * mWinApp->mParticleTasks->GetDriftInterval();
-      tickTime = GetTickCount();
-      elapsed = SEMTickInterval(tickTime, mCamera->GetLastAcquireStartTime());
-      if (interval > elapsed + 1.)
-        mShiftManager->SetGeneralTimeOut(tickTime, (int)(interval - elapsed));
-    }
-    mWinApp->AddIdleTask(CCameraController::TaskCameraBusy, TaskFocusDone,
-      TaskFocusError, 0, 0);
-    if (!mUsingExisting && mUseOppositeLDArea)
-      mCamera->OppositeLDAreaNextShot();
-    if (!mUsingExisting) {
-        if (!mUseOppositeLDArea)
-          mCamera->SetLDwasSetToArea(mFocusAreaNum);
-        mCamera->InitiateCapture(mFocusSetNum);
-    }
-    return;
-  }
-
-  //  All three shots done, get the triple correlation
-  XCorrSetCTF(mSigma1, sigma2use, 0., radius2use, mCTFa, nxpad, nypad, &delta);
-
-  if (erasePeaks) {
-    NewArray2(cArray, float, nypad, (nxpad + 2));
-    if (!cArray)
-      erasePeaks = false;
-    if (mImBufs->GetTiltAngle(tiltA) && mImBufs->GetAxisAngle(axisAngle))
-      tiltAngles[0] = tiltAngles[1] = tiltA;
-  }
-
-  if (mNumShots == 3) {
-    if (erasePeaks) {
-      XCorrPeriodicCorr(mFocusBuf[0], mFocusBuf[1], cArray, nxpad, nypad, delta, mCTFa,
-        tiltAngles, axisAngle, 0, 0.);
-      memcpy(mFocusBuf[1], mFocusBuf[4], 4 * nypad * (nxpad + 2));
-      XCorrPeriodicCorr(mFocusBuf[1], mFocusBuf[2], cArray, nxpad, nypad, delta, mCTFa,
-        tiltAngles, axisAngle, 0, 0.);
-
-    } else {
-      XCorrTripleCorr(mFocusBuf[0], mFocusBuf[1], mFocusBuf[2], nxpad, nypad,
-        delta, mCTFa);
-    }
-
-    XCorrPeakFind(mFocusBuf[0], nxpad+2, nypad, xPeak1, yPeak1, peak1, 2);
-    XCorrPeakFind(mFocusBuf[1], nxpad+2, nypad, xPeak2, yPeak2, peak2, 2);
-    ind1 = CheckZeroPeak(xPeak1, yPeak1, peak1, binning);
-    ind2 = CheckZeroPeak(xPeak2, yPeak2, peak2, -binning);
-
-    // INVERT THOSE Y VALUES to make shifts properly rotatable
-    xShift = binning * (xPeak1[ind1] - xPeak2[ind2]) / 2;
-    yShift = binning * (yPeak2[ind2] - yPeak1[ind1]) / 2;
-    xDrift = binning * (xPeak2[ind2] + xPeak1[ind1]) / 2;
-    yDrift = -binning * (yPeak2[ind2] + yPeak1[ind1]) / 2;
-  } else {
-    if (erasePeaks) {
-      XCorrPeriodicCorr(mFocusBuf[0], mFocusBuf[1], cArray, nxpad, nypad, delta, mCTFa,
-        tiltAngles, axisAngle, 0, 0.);
-    } else {
-      XCorrCrossCorr(mFocusBuf[0], mFocusBuf[1], nxpad, nypad, delta, mCTFa);
-    }
-    XCorrPeakFind(mFocusBuf[0], nxpad+2, nypad, xPeak1, yPeak1, peak1, 2);
-    ind1 = CheckZeroPeak(xPeak1, yPeak1, peak1, binning);
-    xShift =  binning * xPeak1[ind1];
-    yShift = -binning * yPeak1[ind1];
-  }
-  delete [] cArray;
-
-  // Display correlation in buffer A if requested
-  if (mFocusWhere == FOCUS_SHOW_CORR) {
-    float corMin, corMax;
-    mWinApp->mProcessImage->CorrelationToBufferA(mFocusBuf[0], nxpad, nypad, needBin,
-      corMin, corMax);
-    mWinApp->SetCurrentBuffer(0);
-  }
-
-  // Compute unfiltered normalized CCC
-  CCC = XCorrCCCoefficient(mFocusBuf[3], mFocusBuf[4], nxpad + 2, nxpad, nypad,
-    -xPeak1[ind1], -yPeak1[ind1], (nxpad + 1 - nxuse) / 2, (nypad + 1 - nyuse) /2, &ix0);
-
-  for (int ibuf = 0; ibuf < 5; ibuf++) {
-    if (mFocusBuf[ibuf])
-      delete [] mFocusBuf[ibuf];
-    mFocusBuf[ibuf] = NULL;
-  }
-
-  mLastFailed = false;
-  mDriftStored = mNumShots == 3;
-  mRequiredBWMean = -1.;
-  mFocusIndex = -1;
-  mScope->SetBeamTilt(mBaseTiltX, mBaseTiltY);
-  if (mAppliedOffset)
-    mScope->IncDefocus(-mAppliedOffset);
-  mAppliedOffset = 0.;
+  if (index < 2)
+    memcpy(mFocusBuf[index + 3], mFocusBuf[index], 4 * nypad * (nxpad + 2));
+  return 0;
+}
 
-  // Prepare report and store the drift values
-  CString strBin = binning > divForK2 ? "unbinned" : "";
-  report.Format("Tilt-induced shift is %6.2f, %6.2f %s pixels, unfiltered CCC is %.4f",
-    -xShift / divForK2, -yShift / divForK2, strBin, CCC);
-  if (mNumShots == 3) {
-    CString strTemp;
-    imRot = 1000. * mShiftManager->GetPixelSize(iCam, mFocusMag)
-      / (mBufTimeStamp[2] - mBufTimeStamp[0]);
-    mLastDriftX = -(float)(xDrift * imRot);
-    mLastDriftY = -(float)(yDrift * imRot);
-    mLastNmPerSec = (float)(imRot * sqrt(xDrift * xDrift + yDrift * yDrift));
-    strTemp.Format("\r\nThe average drift between shots was %6.1f, %6.1f %s pixels, "
-      "%.2f nm/sec", xDrift / divForK2, yDrift / divForK2, strBin, mLastNmPerSec);
-    report += strTemp;
-    mLastDriftImageTime = mCamera->GetLastAcquireStartTime();
+// Set the beam tilt for the next shot, which has already been counted in mFocusIndex,
+// and start the capture
+void CFocusManager::StartNextFocusShot()
+{
+  float interval;
+  double elapsed;
+  UINT tickTime;
+  int sign = 3 - 2 * mFocusIndex;
+  //PrintfToLog("Set beam tilt to %.2f, %.2f", mBaseTiltX + mNextXtiltOffset + mFracTiltX * sign * mWorkingBT,
+  //  mBaseTiltY + mNextYtiltOffset + mFracTiltY * sign * mWorkingBT);
+  mScope->SetBeamTilt(mBaseTiltX + mNextXtiltOffset + mFracTiltX * sign * mWorkingBT,
+    mBaseTiltY + mNextYtiltOffset + mFracTiltY * sign * mWorkingBT);
+  if (mPostTiltDelay > 0)
+    Sleep(mPostTiltDelay);
+  if (mWinApp->mParticleTasks->GetWaitingForDrift()) {
+    interval = 500.f * mWinApp->mParticleTasks->GetDriftInterval();
+    tickTime = GetTickCount();
+    elapsed = SEMTickInterval(tickTime, mCamera->GetLastAcquireStartTime());
+    if (interval > elapsed + 1.)
+      mShiftManager->SetGeneralTimeOut(tickTime, (int)(interval - elapsed));
   }
-
-  // Temporary report
-//  if (mFocusWhere != FOCUS_REPORT)
-//    mWinApp->AppendToLog(report, LOG_SWALLOW_IF_NOT_ADMIN_OR_OPEN);
-
-  switch (mFocusWhere) {
-    case FOCUS_CALIBRATE:
-      CalFocusData(xShift, yShift);
-      break;
-
-    case FOCUS_AUTOFOCUS:
-      if (mVerbose && !mWinApp->mParticleTasks->GetWaitingForDrift())
-        mWinApp->VerboseAppendToLog(true, report);
-      AutoFocusData(xShift, yShift);
-      break;
-
-    case FOCUS_CAL_ASTIG:
-    case FOCUS_ASTIGMATISM:
-    case FOCUS_COMA_FREE:
-      mWinApp->mAutoTuning->TuningFocusData(xShift, yShift);
-      break;
-
-    case FOCUS_EXISTING:
-    case FOCUS_REPORT:
-    case FOCUS_SHOW_CORR:
-    case FOCUS_SHOW_STRETCH:
-      mWinApp->AppendToLog(report, LOG_MESSAGE_IF_CLOSED);
-      FocusTasksFinished();
-      break;
+  mWinApp->AddIdleTask(CCameraController::TaskCameraBusy, TaskFocusDone,
+    TaskFocusError, 0, 0);
+  if (!mUsingExisting && mUseOppositeLDArea)
+    mCamera->OppositeLDAreaNextShot();
+  if (!mUsingExisting) {
+      if (!mUseOppositeLDArea)
+        mCamera->SetLDwasSetToArea(mFocusAreaNum);
+      mCamera->InitiateCapture(mFocusSetNum);
   }
 }
 
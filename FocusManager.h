@@ -101,6 +101,9 @@ public:
   BOOL FocusReady(int magInd = -1, bool *calibrated = NULL);
   void DetectFocus(int inWhere, int useViewInLD = 0);
   void FocusDone();
+  int PrepareFocusImage(int bufnum, int index, int &binning, int &needBin, int &nxuse,
+    int &nyuse, int &nxpad, int &nypad, float &radius2use, float &sigma2use);
+  void StartNextFocusShot();
   static void TaskFocusDone(int param);
   static void TaskFocusError(int error);
   void StopFocusing();
@@ -182,6 +185,7 @@ private:
   bool mUsingExisting;      // Flag for any mode using existing images
   float *mFocusBuf[5];
   double mBufTimeStamp[3];  // For storing the time stamp when the image comes in
+  double mPrepOverlapTime;  // Time spent preparing images while next one is acquired
   float mFCsx, mFCsxy1, mFCsy1, mFCsxsq; // Sums for n-point line fit
   float mFCsxy2, mFCsy2;
   int mNumCalLevels;        // Number of focus levels to get calibration at
@@ -31,6 +31,9 @@
 #define REF_SECOND_SHOT 2
 #define REAL_FRAME_SHOT 3
 #define REF_SERVER_SHOTS 4
+#define SUM_PIX_PER_THREAD  500000.
+#define MAX_SUM_THREADS  8
+#define NOISY_VARIANCE_CRIT 10.
 
 /////////////////////////////////////////////////////////////////////////////
 // CGainRefMaker
@@ -53,6 +56,11 @@ CGainRefMaker::CGainRefMaker()
   mCalibrateDose = true;
   mStoreMRC = NULL;
   mArray = NULL;
+  mMeanArray = NULL;
+  mSqDevArray = NULL;
+  mFrameCopy = NULL;
+  mCopyBytes = 0;
+  mSumThread = NULL;
   mNumRefKVs = 0;
   mHTValue = 0;
   mDMrefAskPolicy = DMREF_ASK_IF_NEWER;
@@ -130,7 +138,7 @@ void CGainRefMaker::AcquireGainRef()
 {
   int fracField, tsizeX, tsizeY;
   int i, numOdd = 0, numUsableOdd = 0;
-  size_t j, arrSize;
+  size_t j;
   FileOptions fileOpt;
   CFileStatus status;
 
@@ -249,15 +257,21 @@ void CGainRefMaker::AcquireGainRef()
 
   mModuloSaveX = mParam->moduloX;
   mModuloSaveY = mParam->moduloY;
-  arrSize = (size_t)mParam->sizeX * mParam->sizeY /
+  mArraySize = (size_t)mParam->sizeX * mParam->sizeY /
     (mParam->gainRefBinning * mParam->gainRefBinning);
-  NewArray(mArray,float,arrSize);
-  if (!mArray) {
+
+  // Frames are accumulated in double precision as a running mean and sum of squared
+  // deviations.  The frame copy is allocated when the data type is known
+  NewArray(mMeanArray, double, mArraySize);
+  NewArray(mSqDevArray, double, mArraySize);
+  if (!mMeanArray || !mSqDevArray) {
+    DeleteSumArrays();
     AfxMessageBox("Failed to get memory for gain reference", MB_EXCLAME);
     return;
   }
-  for (j = 0; j < arrSize; j++)
-    mArray[j] = 0.;
+  for (j = 0; j < mArraySize; j++)
+    mMeanArray[j] = mSqDevArray[j] = 0.;
+  mNumSummed = 0;
 
   // Rename file now to flush out errors
   mFileName = ComposeRefName(mParam->gainRefBinning);
@@ -474,12 +488,10 @@ void CGainRefMaker::AcquiringRefNextTask(int param)
   int nx, ny, binning, i, j, timeout, outSizeX, outSizeY, top, left, bottom, right;
   float curMean, mean, binRat, exposure, targetExposure, minVal;
   double sum = 0.;
-  double sum2 = 0.;
-  double tsum;
+  double val;
   float *arrpt, *inpt;
   unsigned short int *usdata;
-  short int *sdata;
-  float *fdata;
+  BOOL simulating;
 
   if (param == REF_SERVER_SHOTS) {
     if (mStartingServerFrames && !mDEcurReferenceType && mDEcurProcessType < 2 &&
@@ -563,38 +575,51 @@ void CGainRefMaker::AcquiringRefNextTask(int param)
 
   case REAL_FRAME_SHOT:
 
-    // Check the image size to avoid problems on summing
+    // Make sure the last frame is summed, then check the image size to avoid problems
+    if (WaitForFrameSum()) {
+      AfxMessageBox("An error occurred summing the frames\n\n"
+        "Gain reference aborted.", MB_EXCLAME);
+      StopAcquiringRef();
+      return;
+    }
     nx = image->getWidth();
     ny = image->getHeight();
-    if (nx != mExpectedX || ny != mExpectedY) {
-      AfxMessageBox("The acquired image is not the expected size\n\n"
+    i = image->getType();
+    if (nx != mExpectedX || ny != mExpectedY || (i != kSHORT && i != kUSHORT &&
+      i != kFLOAT)) {
+      AfxMessageBox("The acquired image is not the expected size or type\n\n"
         "Gain reference aborted.", MB_EXCLAME);
       StopAcquiringRef();
       return;
     }
 
-    // Add the data into the real array
+    // Copy the data and sum it into the arrays in a thread while the next frame is
+    // being acquired.  The copy is sized for the first frame's type, so later frames
+    // must match it
+    if (mFrameCopy && i != mCopyType) {
+      AfxMessageBox("The acquired image has a different data type from the first frame"
+        "\n\nGain reference aborted.", MB_EXCLAME);
+      StopAcquiringRef();
+      return;
+    }
     image->Lock();
-    switch (image->getType()) {
-    case kSHORT:
-      sdata = (short int *)image->getData();
-      for (i = 0; i < nx * ny; i++)
-        mArray[i] += sdata[i];
-      break;
-
-    case kUSHORT:
-      usdata = (unsigned short int *)image->getData();
-      for (i = 0; i < nx * ny; i++)
-        mArray[i] += usdata[i];
-      break;
-
-    case kFLOAT:
-      fdata = (float *)image->getData();
-      for (i = 0; i < nx * ny; i++)
-        mArray[i] += fdata[i];
-      break;
+    mCopyType = i;
+    if (!mFrameCopy) {
+      mCopyBytes = (size_t)nx * ny * (mCopyType == kFLOAT ? 4 : 2);
+      NewArray(mFrameCopy, char, mCopyBytes);
+      if (!mFrameCopy) {
+        image->UnLock();
+        AfxMessageBox("Failed to get memory for gain reference", MB_EXCLAME);
+        StopAcquiringRef();
+        return;
+      }
     }
+    memcpy(mFrameCopy, image->getData(), mCopyBytes);
     image->UnLock();
+    mSumThread = AfxBeginThread(SumFrameProc, this, THREAD_PRIORITY_NORMAL, 0,
+      CREATE_SUSPENDED);
+    mSumThread->m_bAutoDelete = false;
+    mSumThread->ResumeThread();
     mFrameCount--;
     timeout = 120000;
     break;
@@ -610,30 +635,46 @@ void CGainRefMaker::AcquiringRefNextTask(int param)
     return;
   }
 
+  // Finish the sum and report on noisy pixels, then free the arrays not needed
+  if (WaitForFrameSum()) {
+    AfxMessageBox("An error occurred summing the frames\n\n"
+      "Gain reference aborted.", MB_EXCLAME);
+    StopAcquiringRef();
+    return;
+  }
+  ReportPixelVariance(nx * ny);
+  delete [] mSqDevArray;
+  delete [] mFrameCopy;
+  mSqDevArray = NULL;
+  mFrameCopy = NULL;
+  mCopyBytes = 0;
+
   // Try to calibrate the dose if selected and binning <= 2
   if (mCalibrateDose && mParam->countsPerElectron > 0. && mParam->gainRefBinning <= 2)
     mWinApp->mBeamAssessor->CalibrateElectronDose(false);
 
-  // Divide array by its mean
-  for (i = 0; i < nx * ny; i++)
-    sum += mArray[i];
-  arrpt = mArray;
-  for (i = 0; i < ny; i++) {
-    tsum = 0.;
-    for (j = 0; j < nx; j++)
-      tsum += *arrpt++;
-    sum2 += tsum;
+  // Divide the mean array by its mean into the reference array
+  NewArray(mArray, float, mArraySize);
+  if (!mArray) {
+    AfxMessageBox("Failed to get memory for gain reference", MB_EXCLAME);
+    StopAcquiringRef();
+    return;
   }
+  for (i = 0; i < nx * ny; i++)
+    sum += mMeanArray[i];
 
-  mean = (float)(sum2 / (nx * ny));
-  SEMTrace('r', "quick sum %.0f  careful sum %.0f  mean %.1f", sum, sum2, mean);
-  if (mWinApp->mScope->GetSimulationMode()) {
-    for (i = 0; i < nx * ny; i++)
-      mArray[i] = (mArray[i] - mean) / 8.f + mean;
-  }
+  mean = (float)(sum / (nx * ny));
+  SEMTrace('r', "sum %.0f  mean %.1f", sum * mNumSummed, mean * mNumSummed);
   minVal = mean / GAINREF_MAX_VAL;
-  for (i = 0; i < nx * ny; i++)
-    mArray[i] = (mArray[i] > minVal) ? mean / mArray[i] : GAINREF_MAX_VAL;
+  simulating = mWinApp->mScope->GetSimulationMode();
+  for (i = 0; i < nx * ny; i++) {
+    val = (float)mMeanArray[i];
+    if (simulating)
+      val = (val - mean) / 8. + mean;
+    mArray[i] = (val > minVal) ? (float)(mean / val) : GAINREF_MAX_VAL;
+  }
+  delete [] mMeanArray;
+  mMeanArray = NULL;
 
   // Repack the block-Tietz reference and pad with 1's
   if (mParam->TietzType && mParam->TietzBlocks) {
@@ -760,6 +801,8 @@ void CGainRefMaker::StopAcquiringRef()
   mTakingRefImages = false;
   mPreparingGainRef = false;
   if (!mStartingServerFrames) {
+    WaitForFrameSum();
+    DeleteSumArrays();
     if (mArray)
       delete mArray;
     mArray = NULL;
@@ -780,6 +823,105 @@ void CGainRefMaker::StopAcquiringRef()
   mWinApp->SetStatusText(MEDIUM_PANE, "");
 }
 
+// Add the copied frame into the sums and sums of squares
+void CGainRefMaker::AccumulateFrame()
+{
+  int i, numThreads, nxy = mExpectedX * mExpectedY;
+  double val, delta, invNum = 1. / (mNumSummed + 1);
+  short *sdata = (short *)mFrameCopy;
+  unsigned short *usdata = (unsigned short *)mFrameCopy;
+  float *fdata = (float *)mFrameCopy;
+  numThreads = B3DNINT(nxy / SUM_PIX_PER_THREAD);
+  B3DCLAMP(numThreads, 1, MAX_SUM_THREADS);
+  numThreads = numOMPthreads(numThreads);
+
+  // Update the running mean and sum of squared deviations (Welford's method)
+#define ACCUMULATE_PIXELS(data) \
+  for (i = 0; i < nxy; i++) { \
+    val = (double)data[i]; \
+    delta = val - mMeanArray[i]; \
+    mMeanArray[i] += delta * invNum; \
+    mSqDevArray[i] += delta * (val - mMeanArray[i]); \
+  }
+
+  if (mCopyType == kSHORT) {
+#pragma omp parallel for num_threads(numThreads) \
+  shared(nxy, sdata, invNum) private(i, val, delta)
+    ACCUMULATE_PIXELS(sdata);
+  } else if (mCopyType == kUSHORT) {
+#pragma omp parallel for num_threads(numThreads) \
+  shared(nxy, usdata, invNum) private(i, val, delta)
+    ACCUMULATE_PIXELS(usdata);
+  } else {
+#pragma omp parallel for num_threads(numThreads) \
+  shared(nxy, fdata, invNum) private(i, val, delta)
+    ACCUMULATE_PIXELS(fdata);
+  }
+#undef ACCUMULATE_PIXELS
+  mNumSummed++;
+}
+
+// The thread procedure for summing a frame
+UINT CGainRefMaker::SumFrameProc(LPVOID pParam)
+{
+  CGainRefMaker *maker = (CGainRefMaker *)pParam;
+  maker->AccumulateFrame();
+  return 0;
+}
+
+// Wait for the thread summing a frame to finish; returns 1 if it ended with an error
+int CGainRefMaker::WaitForFrameSum()
+{
+  int busy;
+  while ((busy = UtilThreadBusy(&mSumThread)) > 0)
+    Sleep(5);
+  return busy < 0 ? 1 : 0;
+}
+
+// Convert the squared deviations to variances and report the number of pixels whose
+// variance is much higher than the mean variance, which may be hot or noisy
+void CGainRefMaker::ReportPixelVariance(int numPix)
+{
+  int i, numThreads, numNoisy = 0, num = mNumSummed;
+  double sumVar = 0., var, meanVar, critVar;
+  if (num < 2)
+    return;
+  numThreads = B3DNINT(numPix / SUM_PIX_PER_THREAD);
+  B3DCLAMP(numThreads, 1, MAX_SUM_THREADS);
+  numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numPix, num) private(i, var) reduction(+:sumVar)
+  for (i = 0; i < numPix; i++) {
+    var = mSqDevArray[i] / (num - 1);
+    mSqDevArray[i] = var;
+    sumVar += var;
+  }
+  meanVar = sumVar / numPix;
+  critVar = NOISY_VARIANCE_CRIT * meanVar;
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numPix, critVar) private(i) reduction(+:numNoisy)
+  for (i = 0; i < numPix; i++)
+    if (mSqDevArray[i] > critVar)
+      numNoisy++;
+  SEMTrace('r', "Mean per-pixel variance over %d frames is %.2f", num, meanVar);
+  if (numNoisy)
+    PrintfToLog("%d pixels in the gain reference frames had a variance more than %.0f"
+      " times the mean variance of %.1f;\r\n   these may be hot or noisy pixels",
+      numNoisy, NOISY_VARIANCE_CRIT, meanVar);
+}
+
+// Delete the arrays used for summing frames
+void CGainRefMaker::DeleteSumArrays()
+{
+  delete [] mMeanArray;
+  delete [] mSqDevArray;
+  delete [] mFrameCopy;
+  mMeanArray = NULL;
+  mSqDevArray = NULL;
+  mFrameCopy = NULL;
+  mCopyBytes = 0;
+}
+
 // Look up the existing references for the current camera if it hasn't happened before
 void CGainRefMaker::FindExistingReferences()
 {
@@ -1361,11 +1503,17 @@ void CGainRefMaker::CheckChangedKV(void)
   }
 }
 
-// Add up the memory usage of all the resident references
+// Add up the memory usage of all the resident references and of the arrays for a
+// reference being acquired
 double CGainRefMaker::MemoryUsage(void)
 {
   CameraParameters *param = mWinApp->GetCamParams();
   double size, sum = 0;
+  if (mMeanArray)
+    sum += 8. * mArraySize;
+  if (mSqDevArray)
+    sum += 8. * mArraySize;
+  sum += (double)mCopyBytes;
   for (int i = 0; i < MAX_CAMERAS; i++) {
     for (int j = 0; j < 2; j++) {
       if (mGainRef[i][j]) {
@@ -69,6 +69,11 @@ public:
   void CheckChangedKV(void);
   double MemoryUsage(void);
   BOOL NeedsUnbinnedRef(int binning);
+  void AccumulateFrame();
+  static UINT SumFrameProc(LPVOID pParam);
+  int WaitForFrameSum();
+  void ReportPixelVariance(int numPix);
+  void DeleteSumArrays();
 
 
 // Overrides
@@ -101,7 +106,15 @@ private:
   CString mDMRefPath;               // Path to DM references
   CString mRemoteRefPath;           // Path to Remote Socket references
   int mCurrentCamera;
-  float *mArray;                    // array that ref is accumulated into
+  float *mArray;                    // array that ref is made in
+  double *mMeanArray;               // Running mean of frames
+  double *mSqDevArray;              // Running sum of squared deviations from the mean
+  char *mFrameCopy;                 // Copy of last frame for summing in thread
+  size_t mCopyBytes;                // Size of the copy
+  int mCopyType;                    // Data type of the copy
+  int mNumSummed;                   // Number of frames summed
+  size_t mArraySize;                // Number of pixels in reference array
+  CWinThread *mSumThread;           // Thread for summing frame
   int mFrameCount;                  // Counter for frames to go
   CString mFileName;                // Current file name for ref being made
   CString mBackupName;              // Name that it was copied to
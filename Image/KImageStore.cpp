@@ -18,6 +18,10 @@
 #define new DEBUG_NEW
 #endif
 
+// Get statistics for writing on threads with one band of lines per this many pixels
+#define WRITE_PIX_PER_THREAD  1000000.
+#define MAX_WRITE_THREADS  8
+
 
 KImageStore::KImageStore(CString inFilename)
   : KImageBase()
@@ -532,9 +536,37 @@ int KImageStore::lookupPixSize(int inMode)
   return pixSize;
 }
 
-// Get the min, max, and mean of the data in a buffer
+// Get the min, max, and mean of the data in a buffer, in bands of lines on threads
 void KImageStore::minMaxMean(char * idata, float & fMin,
                              float & fMax, double & outMean)
+{
+  float bandMin[MAX_WRITE_THREADS], bandMax[MAX_WRITE_THREADS];
+  double bandSum[MAX_WRITE_THREADS];
+  double theSum = 0;
+  int band, numThreads;
+
+  numThreads = B3DNINT((double)mWidth * mHeight / WRITE_PIX_PER_THREAD);
+  B3DCLAMP(numThreads, 1, B3DMIN(MAX_WRITE_THREADS, mHeight));
+  numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(idata, numThreads, bandMin, bandMax, bandSum) private(band)
+  for (band = 0; band < numThreads; band++)
+    linesMinMaxSum(idata, (band * mHeight) / numThreads, 
+      ((band + 1) * mHeight) / numThreads, bandMin[band], bandMax[band], bandSum[band]);
+
+  fMin = bandMin[0];
+  fMax = bandMax[0];
+  for (band = 0; band < numThreads; band++) {
+    ACCUM_MIN(fMin, bandMin[band]);
+    ACCUM_MAX(fMax, bandMax[band]);
+    theSum += bandSum[band];
+  }
+  outMean = theSum / (mHeight * mWidth);
+}
+
+// Get the min, max and sum of the data in lines from jStart up to jEnd
+void KImageStore::linesMinMaxSum(char * idata, int jStart, int jEnd, float & fMin,
+  float & fMax, double & theSum)
 {
   float fVal, fSum;
   int theMin, theMax;
@@ -544,18 +576,19 @@ void KImageStore::minMaxMean(char * idata, float & fMin,
   short *sdata;
   float *fdata;
   unsigned char *bdata;
+  size_t offset = (size_t)jStart * mWidth;
 
   theMin = 66000;
   theMax = -66000;
   fMin = 1.e38f;
   fMax = -1.e38f;
   int tmpSum;
-  double theSum = 0;
-  sdata = (short *)idata;
-  usdata = (unsigned short *)idata;
-  bdata =  (unsigned char *) idata;
-  fdata = (float *)idata;
-  for (j = 0; j < mHeight; j++) {
+  theSum = 0;
+  sdata = (short *)idata + offset;
+  usdata = (unsigned short *)idata + offset;
+  bdata =  (unsigned char *) idata + offset;
+  fdata = (float *)idata + offset;
+  for (j = jStart; j < jEnd; j++) {
     tmpSum = 0;
 
     switch (mMode) {
@@ -616,12 +649,10 @@ void KImageStore::minMaxMean(char * idata, float & fMin,
 
     }
   }
-  outMean = theSum / (mHeight * mWidth);
   if (mMode != 2) {
     fMin = (float)theMin;
     fMax = (float)theMax;
   }
-
 }
 
 // Convert the data array as needed based on image and file mode and policies,
@@ -82,6 +82,8 @@ public:
   virtual int     getPcoord(int inSect, int &outX, int &outY, int &outZ, bool gotMutex = false) {return -1;};
   virtual int     getStageCoord(int inSect, double &outX, double &outY) {return -1;};
   virtual KImage  *getRect(void) {return NULL;};
+  virtual KImage  *getBinnedRect(int ix0, int ix1, int iy0, int iy1, int binning)
+    {return NULL;};
   virtual int     ReorderPieceZCoords(int *sectOrder) { return -1; };
   virtual int     setMode(int inMode) {return 0;};
   virtual bool    fileIsShrMem() { return false; };
@@ -99,10 +101,13 @@ public:
   virtual void    SetSignedOption(int inOpt) {mFileOpt.signToUnsignOpt = inOpt;};
   virtual void    SetCompression(int inComp) {mFileOpt.compression = inComp;};
   virtual int     GetCompression() {return mFileOpt.compression;};
+  virtual int     GetHdfCompression() {return mFileOpt.hdfCompression;};
 	
 	virtual float   getPixel(KCoord &inCoord);
   virtual float   getLastIntTruncation() {return mFracIntTrunc;};
   virtual void    setName(CString inName) {mFilename = inName;};
+  void linesMinMaxSum(char * idata, int jStart, int jEnd, float & fMin, float & fMax,
+    double & theSum);
   virtual void    minMaxMean(char * idata, float & outMin, float & outMax, 
     double & outMean);
   virtual char    *convertForWriting(KImage *inImage, bool needFlipped, bool &needToReflip,
@@ -16,6 +16,10 @@
 #define new DEBUG_NEW
 #endif
 
+// Thread one band of rows per this many pixels being converted, up to the maximum
+#define PIXMAP_PIX_PER_THREAD  250000.
+#define MAX_PIXMAP_THREADS  8
+
 
 KPixMap::KPixMap()
 {
@@ -62,7 +66,9 @@ int KPixMap::useRect(KImage *inRect, bool keepBGRorder)
   float *fdata;
   unsigned char *bdata;
   int theMin, theRange;
-  float fMin, fRange, fScale, fval;
+  float fMin, fRange, fScale, fOffset, fval;
+  unsigned char *lut;
+  int numThreads;
 
   inRect->getSize(width, height);
   inRect->getShifts(fShiftX, fShiftY);
@@ -135,46 +141,59 @@ int KPixMap::useRect(KImage *inRect, bool keepBGRorder)
     if (theType != kFLOAT && theType != kRGB)
       SetLut(theType, theMin, B3DMAX(1, theRange));
 
-    // Copy data row by row with look-up
+    // Copy data row by row with look-up, in bands of rows on multiple threads when the
+    // image is big enough.  The per-type loops are kept free of branches so that the
+    // compiler can vectorize them
     for (j = 0; j < startFillY; j++) {
       bdata = (unsigned char *)mRect->getRowData(j);
       for (i = 0; i < fillFac * width; i++)
         bdata[i] = 127;
     }
 
-    for(j = startFillY; j < endFillY; j++){
+    numThreads = B3DNINT((double)nCopyX * (endFillY - startFillY) /
+      PIXMAP_PIX_PER_THREAD);
+    B3DCLAMP(numThreads, 1, MAX_PIXMAP_THREADS);
+    numThreads = numOMPthreads(numThreads);
+    fOffset = -fMin * fScale;
+#pragma omp parallel for num_threads(numThreads) \
+  shared(startFillY, endFillY, fillFac, theShiftX, theShiftY, theOffset, nCopyX, \
+  theType, inRect, fScale, fOffset, blueInd, redInd) \
+  private(j, i, bdata, ucdata, sdata, usdata, fdata, fval, lut)
+    for (j = startFillY; j < endFillY; j++) {
       bdata = (unsigned char *)mRect->getRowData(j);
       for (i = 0; i < fillFac * theShiftX; i++)
         *bdata++ = 127;
 
-      switch(theType){
+      switch (theType) {
       case kUBYTE:
         ucdata = (unsigned char *)inRect->getRowData(j - theShiftY) + theOffset;
-        for(i = 0; i < nCopyX; i++)
-          *bdata++ = mLut[*ucdata++];
+        lut = mLut;
+        for (i = 0; i < nCopyX; i++)
+          bdata[i] = lut[ucdata[i]];
         break;
 
       case kSHORT:
         sdata = (short *)inRect->getRowData(j - theShiftY) + theOffset;
-        for(i = 0; i < nCopyX; i++)
-          *bdata++ = mLut[*sdata++ + 32768];
+        lut = mLut + 32768;
+        for (i = 0; i < nCopyX; i++)
+          bdata[i] = lut[sdata[i]];
         break;
 
       case kUSHORT:
         usdata = (unsigned short *)inRect->getRowData(j - theShiftY) + theOffset;
-        for(i = 0; i < nCopyX; i++)
-          *bdata++ = mLut[*usdata++];
+        lut = mLut;
+        for (i = 0; i < nCopyX; i++)
+          bdata[i] = lut[usdata[i]];
         break;
 
       case kFLOAT:
+
+        // Scale as a single multiply-add and clamp with min/max, no branches
         fdata = (float *)inRect->getRowData(j - theShiftY) + theOffset;
-        for(i = 0; i < nCopyX; i++) {
-          fval = fScale * (*fdata++ - fMin);
-          if (fval < 0.)
-            fval = 0.f;
-          if (fval > 255.)
-            fval = 255.f;
-          *bdata++ = (unsigned char)fval;
+        for (i = 0; i < nCopyX; i++) {
+          fval = fScale * fdata[i] + fOffset;
+          fval = B3DMAX(0.f, B3DMIN(255.f, fval));
+          bdata[i] = (unsigned char)fval;
         }
         break;
 
@@ -182,15 +201,15 @@ int KPixMap::useRect(KImage *inRect, bool keepBGRorder)
         ucdata = (unsigned char *)inRect->getRowData(j - theShiftY) + 3 * theOffset;
 
         // The pixmap is BGR like the RGBQUAD structure used in bmiColors
-        for(i = 0; i < nCopyX; i++) {
-          *bdata++ = ucdata[blueInd];
-          *bdata++ = ucdata[1];
-          *bdata++ = ucdata[redInd];
-          ucdata += 3;
+        for (i = 0; i < nCopyX; i++) {
+          bdata[3 * i] = ucdata[3 * i + blueInd];
+          bdata[3 * i + 1] = ucdata[3 * i + 1];
+          bdata[3 * i + 2] = ucdata[3 * i + redInd];
         }
         break;
 
       }
+      bdata += fillFac * nCopyX;
 
       for (i = 0; i < -fillFac * theShiftX; i++)
         *bdata++ = 127;
@@ -20,6 +20,10 @@
 
 const int MRCheadSize = 1024;
 
+// Thread binned reads one band of output lines per this many input pixels
+#define BINNED_READ_PIX_PER_THREAD  500000.
+#define MAX_BINNED_READ_THREADS  8
+
 // Initialize the header with mostly zeroes
 HeaderMRC::HeaderMRC()
 {
@@ -146,6 +150,7 @@ KStoreMRC::KStoreMRC(CString inFilename , FileOptions inFileOpt)
     inFileOpt.montageInMdoc;
   mHead = new HeaderMRC();
   mExtra = NULL;
+  mLastReadZ = -2;
   mPixelSpacing = 1.;
   mMontCoordsInMdoc = false;
   mNumWritten = 0;
@@ -235,6 +240,7 @@ KStoreMRC::KStoreMRC(CFile *inFile)
   long headSize = MRCheadSize;
   mHead = NULL;
   mExtra = NULL;
+  mLastReadZ = -2;
   mPixelSpacing = 1.;
   mMontCoordsInMdoc = false;
   HeaderMRC *head = new HeaderMRC;
@@ -565,36 +571,11 @@ KImage *KStoreMRC::getRect(void)
 
   try{
     BigSeek(mHeadSize, width, height * mPixSize * mCur.z, CFile::begin);
-    KImage *retVal;
-    KImageShort *theSImage;
-    KImageFloat *theFImage;
-    KImageRGB *theCImage;
-    switch(mMode){
-      case 0:
-        retVal = new KImage();
-        retVal->useData(theData, width, height);
-        break;
-      case 1:
-      case MRC_MODE_USHORT:
-        theSImage = new KImageShort();
-        theSImage->setType(mMode == 1 ? kSHORT : kUSHORT);
-        theSImage->useData(theData, width, height);
-        retVal = (KImage *)theSImage;
-        break;
-      case 2:
-        theFImage = new KImageFloat();
-        theFImage->useData(theData, width, height);
-        retVal = (KImage *)theFImage;
-        break;
-      case MRC_MODE_RGB:
-        theCImage = new KImageRGB();
-        theCImage->useData(theData, width, height);
-        retVal = (KImage *)theCImage;
-        break;
-    }
+    KImage *retVal = MakeImageForData(theData, width, height);
 
     Read( theData , (DWORD)secSize);
     retVal->flipY();
+    ReadAheadIfSequential(mCur.z);
 
     if (mHead->next || mAdocIndex >= 0) {
 
@@ -618,6 +599,253 @@ KImage *KStoreMRC::getRect(void)
   }
 }
 
+// Return a subarea of the current section from ix0 to ix1 and iy0 to iy1 (inclusive, in
+// image coordinates with Y inverted from the file), binned by the given amount.  Extra
+// pixels that do not fill a binned pixel are dropped.  The rows are accessed through a
+// view of the file mapping so that only the pages needed are read; if that fails they
+// are read in directly
+KImage *KStoreMRC::getBinnedRect(int ix0, int ix1, int iy0, int iy1, int binning)
+{
+  int nxOut, nyOut, numChan, fyStart, numRows, numThreads, ixOut, iyOut, ix, jx, jy;
+  int chan, line, outInd;
+  size_t rowBytes, outRowBytes;
+  __int64 offset;
+  char *theData, *src, *readBuf = NULL, *outRow, *srcRow;
+  void *viewBase = NULL;
+  HANDLE mapHandle = NULL;
+  KImage *retVal = NULL;
+  float sum, binSq;
+
+  if (mCur.z < 0 || mCur.z >= mDepth || mFile == NULL || binning < 1)
+    return NULL;
+  if ((mMode < 0 || mMode > 2) && mMode != MRC_MODE_USHORT && mMode != MRC_MODE_RGB)
+    return NULL;
+  B3DCLAMP(ix0, 0, mWidth - 1);
+  B3DCLAMP(ix1, ix0, mWidth - 1);
+  B3DCLAMP(iy0, 0, mHeight - 1);
+  B3DCLAMP(iy1, iy0, mHeight - 1);
+  nxOut = (ix1 + 1 - ix0) / binning;
+  nyOut = (iy1 + 1 - iy0) / binning;
+  if (nxOut < 1 || nyOut < 1)
+    return NULL;
+  numChan = mMode == MRC_MODE_RGB ? 3 : 1;
+  binSq = (float)(binning * binning);
+
+  // The rows needed in the file start at the one for the last image row used
+  fyStart = mHeight - (iy0 + nyOut * binning);
+  numRows = nyOut * binning;
+  rowBytes = (size_t)mWidth * mPixSize;
+  outRowBytes = (size_t)nxOut * mPixSize;
+  offset = mHeadSize + (__int64)rowBytes * ((__int64)mHeight * mCur.z + fyStart);
+  NewArray(theData, char, outRowBytes * nyOut);
+  if (!theData)
+    return NULL;
+
+  try {
+    src = MapFileRange(offset, rowBytes * numRows, &mapHandle, &viewBase);
+    if (!src) {
+      NewArray(readBuf, char, rowBytes * numRows);
+      if (!readBuf)
+        throw(-1);
+      BigSeek(mHeadSize, (int)rowBytes, mHeight * mCur.z + fyStart, CFile::begin);
+      Read(readBuf, (DWORD)(rowBytes * numRows));
+      src = readBuf;
+    }
+    retVal = MakeImageForData(theData, nxOut, nyOut);
+
+    // Average each output pixel from the source lines, going down in the file for
+    // successive output lines.  The mode is resolved once per line, with a separate
+    // pixel loop for each data type
+#define BIN_LINE_FROM_SOURCE(typ, conv) \
+    for (ixOut = 0; ixOut < nxOut; ixOut++) { \
+      for (chan = 0; chan < numChan; chan++) { \
+        sum = 0.; \
+        for (jy = 0; jy < binning; jy++) { \
+          line = numRows - 1 - (iyOut * binning + jy); \
+          srcRow = src + rowBytes * line; \
+          ix = (ix0 + ixOut * binning) * numChan + chan; \
+          for (jx = 0; jx < binning; jx++, ix += numChan) \
+            sum += ((typ *)srcRow)[ix]; \
+        } \
+        sum /= binSq; \
+        outInd = ixOut * numChan + chan; \
+        ((typ *)outRow)[outInd] = conv; \
+      } \
+    }
+
+    numThreads = B3DNINT((double)nxOut * nyOut * binSq / BINNED_READ_PIX_PER_THREAD);
+    B3DCLAMP(numThreads, 1, MAX_BINNED_READ_THREADS);
+    numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(nyOut, nxOut, numChan, binning, binSq, numRows, rowBytes, outRowBytes, src, \
+  theData, ix0) \
+  private(iyOut, ixOut, chan, jy, jx, ix, outInd, line, sum, outRow, srcRow)
+    for (iyOut = 0; iyOut < nyOut; iyOut++) {
+      outRow = theData + outRowBytes * iyOut;
+      switch (mMode) {
+        case 0:
+        case MRC_MODE_RGB:
+          BIN_LINE_FROM_SOURCE(unsigned char, (unsigned char)(sum + 0.5f));
+          break;
+        case 1:
+          BIN_LINE_FROM_SOURCE(short, (short)B3DNINT(sum));
+          break;
+        case MRC_MODE_USHORT:
+          BIN_LINE_FROM_SOURCE(unsigned short, (unsigned short)(sum + 0.5f));
+          break;
+        case 2:
+          BIN_LINE_FROM_SOURCE(float, sum);
+          break;
+      }
+    }
+#undef BIN_LINE_FROM_SOURCE
+    UnmapFileRange(mapHandle, viewBase);
+    delete [] readBuf;
+    readBuf = NULL;
+    ReadAheadIfSequential(mCur.z);
+
+    if (mHead->next || mAdocIndex >= 0) {
+      EMimageExtra *theExtra = new EMimageExtra;
+      retVal->SetUserData(theExtra);
+      if (getExtraData(theExtra, mCur.z))
+        throw(-1);
+    }
+    return retVal;
+  }
+  catch(CFileException *perr) {
+    perr->Delete();
+  }
+  catch(int ){
+  }
+  UnmapFileRange(mapHandle, viewBase);
+  delete [] readBuf;
+  if (retVal)
+    delete retVal;
+  else
+    delete [] theData;
+  return NULL;
+}
+
+// Make an image of the type for the file mode that takes over the data array
+KImage *KStoreMRC::MakeImageForData(char *theData, int width, int height)
+{
+  KImage *retVal = NULL;
+  KImageShort *theSImage;
+  KImageFloat *theFImage;
+  KImageRGB *theCImage;
+  switch(mMode){
+    case 0:
+      retVal = new KImage();
+      retVal->useData(theData, width, height);
+      break;
+    case 1:
+    case MRC_MODE_USHORT:
+      theSImage = new KImageShort();
+      theSImage->setType(mMode == 1 ? kSHORT : kUSHORT);
+      theSImage->useData(theData, width, height);
+      retVal = (KImage *)theSImage;
+      break;
+    case 2:
+      theFImage = new KImageFloat();
+      theFImage->useData(theData, width, height);
+      retVal = (KImage *)theFImage;
+      break;
+    case MRC_MODE_RGB:
+      theCImage = new KImageRGB();
+      theCImage->useData(theData, width, height);
+      retVal = (KImage *)theCImage;
+      break;
+  }
+  return retVal;
+}
+
+// Make a read-only mapping of the file and map a view of a range of it starting at the
+// allocation boundary below the offset.  Returns a pointer to the data at the offset, or
+// NULL if the file is not big enough or mapping fails.  The mapping and view are made for
+// each read and must be released with UnmapFileRange, so that no mapping is held on a
+// file that is being written
+char *KStoreMRC::MapFileRange(__int64 offset, size_t size, HANDLE *mapHandle,
+  void **viewBase)
+{
+  static DWORD granularity = 0;
+  SYSTEM_INFO sysInfo;
+  LARGE_INTEGER fileSize;
+  __int64 start;
+  size_t skip;
+  *mapHandle = NULL;
+  *viewBase = NULL;
+  if (!granularity) {
+    GetSystemInfo(&sysInfo);
+    granularity = sysInfo.dwAllocationGranularity;
+  }
+  if (!mFile || !GetFileSizeEx((HANDLE)mFile->m_hFile, &fileSize) ||
+    fileSize.QuadPart < offset + (__int64)size)
+    return NULL;
+  *mapHandle = CreateFileMapping((HANDLE)mFile->m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!*mapHandle)
+    return NULL;
+  start = offset - offset % granularity;
+  skip = (size_t)(offset - start);
+  *viewBase = MapViewOfFile(*mapHandle, FILE_MAP_READ, (DWORD)(start >> 32),
+    (DWORD)(start & 0xFFFFFFFF), size + skip);
+  if (!*viewBase) {
+    UnmapFileRange(*mapHandle, *viewBase);
+    return NULL;
+  }
+  return (char *)*viewBase + skip;
+}
+
+// Unmap a view and close its mapping
+void KStoreMRC::UnmapFileRange(HANDLE &mapHandle, void *&viewBase)
+{
+  if (viewBase)
+    UnmapViewOfFile(viewBase);
+  viewBase = NULL;
+  if (mapHandle)
+    CloseHandle(mapHandle);
+  mapHandle = NULL;
+}
+
+// When sections are being read in order, map the next section and have the system
+// start reading it into memory.  The pages stay in the system file cache after the view
+// is unmapped, so the next read comes from memory
+typedef struct {
+  PVOID VirtualAddress;
+  SIZE_T NumberOfBytes;
+} PrefetchRange;
+typedef BOOL (WINAPI *PrefetchMemFunc)(HANDLE, ULONG_PTR, PrefetchRange *, ULONG);
+
+void KStoreMRC::ReadAheadIfSequential(int sect)
+{
+  static PrefetchMemFunc prefetchFunc = NULL;
+  static bool lookedUp = false;
+  PrefetchRange range;
+  size_t secSize = (size_t)mWidth * mHeight * mPixSize;
+  __int64 offset = mHeadSize + (__int64)secSize * (sect + 1);
+  bool sequential = sect == mLastReadZ + 1;
+  HANDLE mapHandle;
+  void *viewBase;
+  char *data;
+  mLastReadZ = sect;
+
+  // The function is only available in Windows 8 and higher
+  if (!lookedUp) {
+    lookedUp = true;
+    HMODULE module = GetModuleHandle("kernel32.dll");
+    if (module)
+      prefetchFunc = (PrefetchMemFunc)GetProcAddress(module, "PrefetchVirtualMemory");
+  }
+  if (!sequential || sect + 1 >= mDepth || !prefetchFunc)
+    return;
+  data = MapFileRange(offset, secSize, &mapHandle, &viewBase);
+  if (!data)
+    return;
+  range.VirtualAddress = data;
+  range.NumberOfBytes = secSize;
+  prefetchFunc(GetCurrentProcess(), 1, &range, 0);
+  UnmapFileRange(mapHandle, viewBase);
+}
+
 int KStoreMRC::getExtraData(EMimageExtra * extra, int section)
 {
   int i, j, retval = 0;
@@ -48,6 +48,12 @@ class KStoreMRC : public KImageStore
 	Int32      mHeadSize;
 	HeaderMRC *mHead;
 	char       *mExtra;
+  int        mLastReadZ;      // Last section read, to detect sequential reading
+
+  KImage *MakeImageForData(char *theData, int width, int height);
+  char *MapFileRange(__int64 offset, size_t size, HANDLE *mapHandle, void **viewBase);
+  void UnmapFileRange(HANDLE &mapHandle, void *&viewBase);
+  void ReadAheadIfSequential(int sect);
 
 public:
        KStoreMRC(CFile *inFile);
@@ -61,6 +67,7 @@ public:
   const char *GetTitle(int index);
 	
 	virtual KImage  *getRect(void);
+  virtual KImage  *getBinnedRect(int ix0, int ix1, int iy0, int iy1, int binning);
 	virtual float      getPixel(KCoord &inCoord);
 	virtual int     AppendImage(KImage *inImage);
 	virtual int    WriteSection(KImage * inImage, int inSect);
@@ -3449,6 +3449,11 @@ int CMacCmd::ReadFile(void)
     if (index < 0)
       ABORT_LINE("Could not find piece in file for line:\n\n");
   }
+  if (!piece && !mItemEmpty[3] && mItemInt[3] > 1) {
+    if (mWinApp->Montaging())
+      ABORT_LINE("Binning cannot be applied when reading from a montage in line:\n\n");
+    mBufferManager->SetNextReadBinning(mItemInt[3]);
+  }
   if (mWinApp->Montaging() && !piece)
     index2 = mWinApp->mMontageController->ReadMontage(index, NULL, NULL, false, true);
   else {
@@ -6781,6 +6786,13 @@ int CMacCmd::ElapsedTickTime(void)
   return 0;
 }
 
+// ReportTaskLatencies
+int CMacCmd::ReportTaskLatencies(void)
+{
+  mWinApp->ReportTaskLatencies(!mItemEmpty[1] && mItemInt[1] != 0);
+  return 0;
+}
+
 // ReportDateTime
 int CMacCmd::ReportDateTime(void)
 {
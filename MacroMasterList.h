@@ -176,7 +176,7 @@ MAC_SAME_NAME_NOARG(ReportComaTiltNeeded, 0, 0, REPORTCOMATILTNEEDED)
 MAC_SAME_NAME_NOARG(ReportComaVsISmatrix, 0, 0, REPORTCOMAVSISMATRIX)
 MAC_SAME_NAME_ARG(Save, 0, 0, SAVE, si)
 MAC_SAME_FUNC_ARG(S, 0, 0, Save, S, si)
-MAC_SAME_NAME_ARG(ReadFile, 1, 0, READFILE, Is)
+MAC_SAME_NAME_ARG(ReadFile, 1, 0, READFILE, Isi)
 MAC_SAME_NAME_ARG(ReadOtherFile, 3, 4, READOTHERFILE, ISS)
 MAC_SAME_NAME_ARG(RetryReadOtherFile, 1, 4, RETRYREADOTHERFILE, I)
 MAC_SAME_NAME_ARG(SaveToOtherFile, 4, 4, SAVETOOTHERFILE, SSSS)
@@ -884,6 +884,7 @@ MAC_SAME_NAME_ARG(SetZoomedOverviewCenter, 2, 0, SETZOOMEDOVERVIEWCENTER, DD)
 MAC_SAME_FUNC_ARG(AssessPolygonMontage, 2, 4, SetupPolygonMontage, ASSESSPOLYGONMONTAGE, II)
 MAC_SAME_NAME_ARG(GetAllLowDoseValues, 3, 4, GETALLLOWDOSEVALUES, ISSssssssssssssssss)
 MAC_SAME_FUNC_ARG(GetAllCameraSetValues, 3, 4, GetAllLowDoseValues, GETALLCAMERASETVALUES, ISSssssssssssssssss)
+MAC_SAME_NAME_ARG(ReportTaskLatencies, 0, 0, REPORTTASKLATENCIES, i)
 
 // new Python-only commands need to be added to pythonOnlyCmds in ::CMacroProcessor
 // New Not from Python items omit _ARG or _NOARG
@@ -111,7 +111,6 @@ public:
   ScaleMat mMapScaleMat;  // Scale matrix for drawing
   int mMapWidth;          // Size of image at which scale matrix was defined
   int mMapHeight;
-  int mTextExtent;
   float mMapMinScale;     // Min and max scale values of image when map was defined
   float mMapMaxScale;
   int mMapFramesX;        // Number of montage frames when montage acquired
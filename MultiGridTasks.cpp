@@ -68,6 +68,10 @@ CMultiGridTasks::CMultiGridTasks()
   mSuspendedMulGrid = false;
   mRRGcurDirection = -2;
   mRRGMaxRotation = 15.f;
+  mLoadingAllMaps = false;
+  mStopLoadingMaps = false;
+  mMapPrefetchAhead = 2;
+  mPrefetchThread = NULL;
   mRRGmaxCenShift = 50.;
   mRRGShiftLimitForXform = 70.;
   mRRGRotLimitForXform = 17.f;
@@ -5339,6 +5343,9 @@ void CMultiGridTasks::ApplyVectorsIfSavedAndOK(int jcdInd)
 int CMultiGridTasks::LoadAllGridMaps(int startBuf, CString &errStr)
 {
   int ind, jcdInd, numMaps = 0, numLoaded = 0, lowestMag = 999, saveRolls;
+  bool sessionMaps = mCartInfo->GetSize() && mLMMmagIndex > 0;
+  double startTime = GetTickCount();
+  StringVec fileList;
   float pixel, biggestMap, size;
   float minGridMapSize = 400.;
   IntVec mapOrJcdInds;
@@ -5351,7 +5358,7 @@ int CMultiGridTasks::LoadAllGridMaps(int startBuf, CString &errStr)
   mNavigator = mWinApp->mNavigator;
 
   // If there is grid info AND there has been any mapping, count up maps from flags/IDs
-  if (mCartInfo->GetSize() && mLMMmagIndex > 0) {
+  if (sessionMaps) {
     if (!mNavigator)
       mWinApp->mMenuTargets.OpenNavigatorIfClosed();
     mNavigator = mWinApp->mNavigator;
@@ -5416,29 +5423,67 @@ int CMultiGridTasks::LoadAllGridMaps(int startBuf, CString &errStr)
   saveRolls = mWinApp->mBufferManager->GetShiftsOnAcquire();
   mWinApp->mBufferManager->SetShiftsOnAcquire(B3DMIN(saveRolls, startBuf - 1));
   mMultiLoadLabelMap.clear();
-
-  // Loop on maps to load
-  for (jcdInd = 0; jcdInd < (int)mapOrJcdInds.size(); jcdInd++) {
-    if (mCartInfo->GetSize() && mLMMmagIndex > 0) {
+  mapOrJcdInds.resize(numMaps);
+
+  // Start a thread to read the files of upcoming maps while each one is assembled, so
+  // that they come from the system cache.  Session grids have a nav file and a
+  // predictable map file root; otherwise the item has the map file name
+  mPrefetchTD.fileLists.clear();
+  for (jcdInd = 0; jcdInd < numMaps && mMapPrefetchAhead > 0 && numMaps > 1; jcdInd++) {
+    fileList.clear();
+    if (sessionMaps) {
+      fileList.push_back((LPCTSTR)FullGridFilePath(-mapOrJcdInds[jcdInd] - 1, ".nav"));
+      fileList.push_back((LPCTSTR)FullGridFilePath(-mapOrJcdInds[jcdInd] - 1,
+        "_LMM_*"));
+    } else {
+      item = itemArray->GetAt(mapOrJcdInds[jcdInd]);
+      fileList.push_back((LPCTSTR)item->mMapFile);
+      if (item->mMapMontage)
+        fileList.push_back((LPCTSTR)(item->mMapFile + ".mdoc"));
+    }
+    mPrefetchTD.fileLists.push_back(fileList);
+  }
+  if (mPrefetchTD.fileLists.size()) {
+    mPrefetchTD.numLoaded = 0;
+    mPrefetchTD.stop = false;
+    mPrefetchTD.maxAhead = mMapPrefetchAhead;
+    mPrefetchTD.megabytesRead = 0.;
+    mPrefetchThread = AfxBeginThread(MapPrefetchProc, &mPrefetchTD,
+      THREAD_PRIORITY_BELOW_NORMAL, 0, CREATE_SUSPENDED);
+    mPrefetchThread->m_bAutoDelete = false;
+    mPrefetchThread->ResumeThread();
+  }
+
+  // Loop on maps to load, keeping the interface active and showing maps as they appear
+  mLoadingAllMaps = true;
+  mStopLoadingMaps = false;
+  for (jcdInd = 0; jcdInd < numMaps; jcdInd++) {
+    mPrefetchTD.numLoaded = jcdInd;
+    if (sessionMaps) {
 
       // For session map, need to load nav, find map
-      jcd = mCartInfo->GetAt(jcdInd);
-      str = FullGridFilePath(-jcdInd - 1, ".nav");
+      jcd = mCartInfo->GetAt(mapOrJcdInds[jcdInd]);
+      str = FullGridFilePath(-mapOrJcdInds[jcdInd] - 1, ".nav");
       if (mNavigator->LoadNavFile(false, false, &str)) {
+        if (mStopLoadingMaps)
+          break;
         SEMAppendToLog("Error loading Navigator file " + str);
         continue;
       }
+      if (mStopLoadingMaps)
+        break;
 
       item = mNavigator->FindItemWithMapID(jcd.LMmapID);
       if (!item) {
-        PrintfToLog("Could not find map with ID %d in file %s", item->mMapID,
+        PrintfToLog("Could not find map with ID %d in file %s", jcd.LMmapID,
           (LPCTSTR)str);
         continue;
       }
     } else {
 
       // Otherwise get the item
-      item = itemArray->GetAt(jcdInd);
+      item = itemArray->GetAt(mapOrJcdInds[jcdInd]);
+      str = item->mMapFile;
     }
 
     // Load and report
@@ -5452,9 +5497,97 @@ int CMultiGridTasks::LoadAllGridMaps(int startBuf, CString &errStr)
     PrintfToLog("%c: %s  -  %s", (char)('A' + startBuf + numLoaded),
       (LPCTSTR)item->mLabel, (LPCTSTR)item->mNote);
     numLoaded++;
+
+    // Publish the first map right away and the buffer status of the rest
+    if (numLoaded == 1)
+      mWinApp->SetCurrentBuffer(startBuf);
+    else
+      mWinApp->UpdateBufferWindows();
+    SleepMsg(1);
+    if (mStopLoadingMaps)
+      break;
   }
+  if (mStopLoadingMaps)
+    PrintfToLog("Loading of grid maps stopped after %d of %d maps", numLoaded, numMaps);
+  StopMapPrefetch();
+  mLoadingAllMaps = false;
+  mStopLoadingMaps = false;
+  SEMTrace('n', "Loaded %d maps in %.2f sec, prefetched %.0f MB", numLoaded,
+    SEMTickInterval(startTime) / 1000., mPrefetchTD.megabytesRead);
   mWinApp->SetCurrentBuffer(startBuf);
   mWinApp->mBufferManager->SetShiftsOnAcquire(saveRolls);
+  mWinApp->UpdateBufferWindows();
+  return 0;
+}
+
+// Stop the prefetch thread if it is running and wait for it to finish
+void CMultiGridTasks::StopMapPrefetch()
+{
+  if (!mPrefetchThread)
+    return;
+  mPrefetchTD.stop = true;
+  while (UtilThreadBusy(&mPrefetchThread) > 0)
+    Sleep(10);
+}
+
+// Thread procedure to read through the files for upcoming maps in chunks, staying within
+// the given number of maps ahead of the one being loaded.  The data are discarded; the
+// point is to have the files in the system cache when the montage is read from them
+UINT CMultiGridTasks::MapPrefetchProc(LPVOID pParam)
+{
+  MapPrefetchData *td = (MapPrefetchData *)pParam;
+  int mapInd, fileInd;
+  size_t chunkSize = MAP_PREFETCH_CHUNK_MB * 1024 * 1024, numRead;
+  char *buffer = NULL;
+  std::string dir, name;
+  StringVec names;
+  HANDLE hFind;
+  WIN32_FIND_DATA findData;
+  FILE *fp;
+
+  NewArray(buffer, char, chunkSize);
+  if (!buffer)
+    return 1;
+
+  // Start with the second map, the first is being loaded
+  for (mapInd = 1; mapInd < (int)td->fileLists.size() && !td->stop; mapInd++) {
+    while (mapInd > td->numLoaded + td->maxAhead && !td->stop)
+      Sleep(20);
+
+    // Expand any wildcards to get actual file names
+    names.clear();
+    for (fileInd = 0; fileInd < (int)td->fileLists[mapInd].size(); fileInd++) {
+      name = td->fileLists[mapInd][fileInd];
+      if (name.find('*') == std::string::npos) {
+        names.push_back(name);
+        continue;
+      }
+      dir = name.substr(0, name.find_last_of('\\') + 1);
+      hFind = FindFirstFile(name.c_str(), &findData);
+      if (hFind == INVALID_HANDLE_VALUE)
+        continue;
+      do {
+        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+          names.push_back(dir + findData.cFileName);
+      } while (FindNextFile(hFind, &findData));
+      FindClose(hFind);
+    }
+
+    // Read each file through
+    for (fileInd = 0; fileInd < (int)names.size() && !td->stop; fileInd++) {
+      fp = fopen(names[fileInd].c_str(), "rb");
+      if (!fp)
+        continue;
+      while (!td->stop) {
+        numRead = fread(buffer, 1, chunkSize, fp);
+        td->megabytesRead += numRead / (1024. * 1024.);
+        if (numRead < chunkSize)
+          break;
+      }
+      fclose(fp);
+    }
+  }
+  delete [] buffer;
   return 0;
 }
 
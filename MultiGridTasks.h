@@ -28,8 +28,19 @@ enum MultiGridActions {
 #define MGSTAT_FLAG_ACQ_DONE   0x10
 #define MGSTAT_FLAG_NEW_GRID   0x20
 
+#define MAP_PREFETCH_CHUNK_MB  4
+
 class CMultiGridDlg;
 
+// Data for the thread that reads map files ahead of the maps being loaded
+struct MapPrefetchData {
+  std::vector<StringVec> fileLists;  // Filenames or wildcard patterns for each map
+  volatile int numLoaded;            // Number of maps finished by the main thread
+  volatile BOOL stop;                // Flag to stop reading
+  int maxAhead;                      // Maximum number of maps to read ahead
+  double megabytesRead;              // Total amount read
+};
+
 // Structures for saving per-grid parameters and enums for indexing the simple arrays
 enum MShotIndexes {
   MS_spokeRad0, MS_spokeRad1, MS_numShots0, MS_numShots1, MS_numHoles0,
@@ -198,6 +209,9 @@ public:
   GetSetMember(float, PctStatMidCrit);
   GetSetMember(float, PctStatRangeCrit);
   GetSetMember(CString, WorkingDir);
+  GetSetMember(int, MapPrefetchAhead);
+  GetMember(bool, LoadingAllMaps);
+  SetMember(bool, StopLoadingMaps);
   GetSetMember(CString, LastSessionFile);
   SetMember(CString, SessionFilename);
   GetMember(int, NamesLocked);
@@ -307,6 +321,13 @@ private:
   IntVec mLastDfltRunInds;    // Default dialog run indexes when dialog was closed
   int mLastNumSlots;          // And total number of slots then
   std::map<int, std::string> mMultiLoadLabelMap;
+  bool mLoadingAllMaps;       // Flag that all grid maps are being loaded, interface active
+  bool mStopLoadingMaps;      // Flag that user pressed STOP during that
+  int mMapPrefetchAhead;      // Number of map files to read ahead when loading, 0 for none
+  CWinThread *mPrefetchThread;
+  MapPrefetchData mPrefetchTD;
+  static UINT MapPrefetchProc(LPVOID pParam);
+  void StopMapPrefetch();
 
   bool mStartedLongOp;        // Flags for actions that were started
   bool mMovedAperture;
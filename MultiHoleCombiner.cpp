@@ -29,6 +29,7 @@
 #endif
 
 #define XY_IN_GRID(xx, yy) (xx >= 0 && xx < mNxGrid && yy >= 0 && yy < mNyGrid)
+#define MAX_COMBINE_THREADS 8
 
 // Error reporting
 enum {
@@ -59,7 +60,7 @@ CMultiHoleCombiner::CMultiHoleCombiner(void)
 {
   SEMBuildTime(__DATE__, __TIME__);
   mWinApp = (CSerialEMApp *)AfxGetApp();
-
+  mCheckSerialEval = false;
 }
 
 CMultiHoleCombiner::~CMultiHoleCombiner(void)
@@ -99,7 +100,7 @@ int CMultiHoleCombiner::CombineItems(int boundType, BOOL turnOffOutside, int inX
   LowDoseParams *ldp;
   ScaleMat s2c, is2cam, st2is, is2st, gridMat, holeInv, holeMat, prodMat, gridStMat;
   PositionData data;
-  CArray<PositionData, PositionData> fullArray, bestFullArray;
+  CArray<PositionData, PositionData> bestFullArray;
   float avgAngle, spacing, xfit[3], yfit[3];
   double hx, hy;
   float nearIntCrit = 0.33f, near60crit = 15.f;
@@ -131,6 +132,12 @@ int CMultiHoleCombiner::CombineItems(int boundType, BOOL turnOffOutside, int inX
 
   int ori, crossDx[5] = {0, -1, 1, 0, 0}, crossDy[5] = {0, 0, 0, -1, 1};
   int numAdded = 0;
+  int cand, numCands, numThreads, numReused = 0, numLines = 0, pass, passThreads;
+  PositionArray *candArrays, *parArrays = NULL;
+  BoxLineCache *candCaches, *parCaches = NULL;
+  IntVec candNums, candReused, candLines;
+  FloatVec candSds, parSds;
+  double searchStart, parMsec = 0.;
   msParams = &msParamsCopy;
   mHelper = mWinApp->mNavHelper;
   mFindHoles = mHelper->mFindHoles;
@@ -601,29 +608,58 @@ int CMultiHoleCombiner::CombineItems(int boundType, BOOL turnOffOutside, int inX
     }
 
     // Try hexes centered so that the center point is at all possible positions, and
-    // try rows pitched above and below X axis
+    // try rows pitched above and below X axis.  The arrangements are independent so
+    // evaluate them in parallel, then pick the best in order as before.  If checking,
+    // evaluate them again serially and compare
     int bestInd = -1, bestIx;
-    for (ind = 0; ind < (int)mHexDelX.size(); ind++) {
-      for (ix = 0; ix < 2; ix++) {
-        //ind = 0;
-        //ix = 0;
-        fullArray.RemoveAll();
-        num = EvaluateArrangementOfHexes(mNxGrid / 2 - mHexDelX[ind],
-          mNyGrid / 2 - mHexDelY[ind], ix > 0, fullArray, fullSd, iy);
-        //PrintfToLog("ind %d ix %d num %d  sd %.2f", ind, ix, num, fullSd);
-
-        // Missing centers have either been handled by shifting or counted already as
-        // being split into two parts, so go for the smallest # of acquires and the
-        // least variability when there is a tie
-        if (num < minFullNum || (num == minFullNum && fullSd < fullBestSd)) {
-          minFullNum = num;
-          fullBestSd = fullSd;
-          bestFullArray.Copy(fullArray);
-          bestInd = ind;
-          bestIx = ix;
-        }
+    numCands = 2 * (int)mHexDelX.size();
+    candNums.resize(numCands);
+    candSds.resize(numCands);
+    numThreads = NumCombineThreads(numCands);
+    for (pass = 0; pass < (mCheckSerialEval ? 2 : 1); pass++) {
+      if (pass) {
+        parArrays = candArrays;
+        parSds = candSds;
+        parMsec = 1000. * (wallTime() - searchStart);
+      }
+      searchStart = wallTime();
+      candArrays = new PositionArray[numCands];
+      passThreads = pass ? 1 : numThreads;
+#pragma omp parallel for num_threads(passThreads) \
+  shared(numCands, candArrays, candNums, candSds) private(cand, iy)
+      for (cand = 0; cand < numCands; cand++) {
+        iy = 0;
+        candNums[cand] = EvaluateArrangementOfHexes(mNxGrid / 2 - mHexDelX[cand / 2],
+          mNyGrid / 2 - mHexDelY[cand / 2], (cand % 2) > 0, candArrays[cand],
+          candSds[cand], iy);
       }
     }
+    if (parArrays) {
+      CompareSerialEvaluation("hex", numCands, parArrays, parSds, candArrays, candSds,
+        numThreads, parMsec, 1000. * (wallTime() - searchStart));
+      delete[] parArrays;
+      parArrays = NULL;
+    }
+
+    for (cand = 0; cand < numCands; cand++) {
+      num = candNums[cand];
+      fullSd = candSds[cand];
+      //PrintfToLog("ind %d ix %d num %d  sd %.2f", cand / 2, cand % 2, num, fullSd);
+
+      // Missing centers have either been handled by shifting or counted already as
+      // being split into two parts, so go for the smallest # of acquires and the
+      // least variability when there is a tie
+      if (num < minFullNum || (num == minFullNum && fullSd < fullBestSd)) {
+        minFullNum = num;
+        fullBestSd = fullSd;
+        bestFullArray.Copy(candArrays[cand]);
+        bestInd = cand / 2;
+        bestIx = cand % 2;
+      }
+    }
+    delete[] candArrays;
+    SEMTrace('C', "Evaluated %d hex arrangements in %.1f ms with %d threads", numCands,
+      1000. * (wallTime() - searchStart), passThreads);
     // PrintfToLog("Best ind %d ix %d", bestInd, bestIx);
     mHexToItemIndex.clear();
     mHexToItemIndex.resize(bestFullArray.GetSize(), -1);
@@ -833,45 +869,91 @@ int CMultiHoleCombiner::CombineItems(int boundType, BOOL turnOffOutside, int inX
 
     // NORMAL RECTANGULAR PATTERNS
     //
-    // Set up boxes in rows first.  Loop on series of row starts in Y
-    for (rowStart = 1 - mNumYholes; rowStart <= 0; rowStart++) {
-      fullArray.RemoveAll();
-
-      // At each, loop on the possible Y starts to sample the area
-      for (yStart = rowStart; yStart < mNyGrid; yStart += mNumYholes) {
-        TryBoxStartsOnLine(yStart, false, fullArray);
+    // Set up boxes in rows first, then in columns.  Each series of row or column starts
+    // is a candidate that is evaluated independently in parallel.  The best line at each
+    // start depends only on the occupancy of the grid along that line, so lines from
+    // the last run are reused when their region is unchanged.  If checking, evaluate
+    // them again serially and compare
+    mPrevLineCache.swap(mLineCache);
+    mLineCache.clear();
+    numCands = mNumYholes + mNumXholes;
+    candNums.resize(numCands);
+    candSds.resize(numCands);
+    numThreads = NumCombineThreads(numCands);
+    for (pass = 0; pass < (mCheckSerialEval ? 2 : 1); pass++) {
+      if (pass) {
+        parArrays = candArrays;
+        parCaches = candCaches;
+        parSds = candSds;
+        parMsec = 1000. * (wallTime() - searchStart);
       }
+      searchStart = wallTime();
+      candArrays = new PositionArray[numCands];
+      candCaches = new BoxLineCache[numCands];
+      candReused.assign(numCands, 0);
+      candLines.assign(numCands, 0);
+      passThreads = pass ? 1 : numThreads;
+#pragma omp parallel for num_threads(passThreads) \
+  shared(numCands, candArrays, candCaches, candNums, candSds, candReused, candLines) \
+  private(cand, rowStart, colStart, yStart, xStart)
+      for (cand = 0; cand < numCands; cand++) {
+        if (cand < mNumYholes) {
+
+          // Loop on series of row starts in Y; at each, loop on the possible Y starts to
+          // sample the area
+          rowStart = 1 - mNumYholes + cand;
+          for (yStart = rowStart; yStart < mNyGrid; yStart += mNumYholes) {
+            TryBoxStartsOnLine(yStart, false, candArrays[cand], candCaches[cand],
+              candReused[cand]);
+            candLines[cand]++;
+          }
+        } else {
 
-      // Try to merge and get the Sd of # in each; keep track of best one
-      mergeBoxesAndEvaluate(fullArray, fullSd);
-      num = (int)fullArray.GetSize();
-      if (num < minFullNum || (num == minFullNum && fullSd < fullBestSd)) {
-        minFullNum = num;
-        fullBestSd = fullSd;
-        bestFullArray.Copy(fullArray);
-        if (mDebug)
-          PrintfToLog("Best at rowStart %d  num %d  fullSd %.2f", rowStart, num, fullSd);
+          // Similarly in columns
+          colStart = 1 - mNumXholes + cand - mNumYholes;
+          for (xStart = colStart; xStart < mNxGrid; xStart += mNumXholes) {
+            TryBoxStartsOnLine(xStart, true, candArrays[cand], candCaches[cand],
+              candReused[cand]);
+            candLines[cand]++;
+          }
+        }
+
+        // Try to merge and get the Sd of # in each
+        mergeBoxesAndEvaluate(candArrays[cand], candSds[cand]);
+        candNums[cand] = (int)candArrays[cand].GetSize();
       }
     }
+    if (parArrays) {
+      CompareSerialEvaluation("box", numCands, parArrays, parSds, candArrays, candSds,
+        numThreads, parMsec, 1000. * (wallTime() - searchStart));
+      delete[] parArrays;
+      delete[] parCaches;
+      parArrays = NULL;
+    }
 
-    // Now repeat that in columns
-    for (colStart = 1 - mNumXholes; colStart <= 0; colStart++) {
-      fullArray.RemoveAll();
-
-      // At each, loop on the possible X starts to sample the area
-      for (xStart = colStart; xStart < mNxGrid; xStart += mNumXholes) {
-        TryBoxStartsOnLine(xStart, true, fullArray);
-      }
-      mergeBoxesAndEvaluate(fullArray, fullSd);
-      num = (int)fullArray.GetSize();
+    // Keep track of best one, in the original order of evaluation
+    for (cand = 0; cand < numCands; cand++) {
+      num = candNums[cand];
+      fullSd = candSds[cand];
       if (num < minFullNum || (num == minFullNum && fullSd < fullBestSd)) {
         minFullNum = num;
         fullBestSd = fullSd;
-        bestFullArray.Copy(fullArray);
+        bestFullArray.Copy(candArrays[cand]);
         if (mDebug)
-          PrintfToLog("Best at colStart %d  num %d  fullSd %.2f", colStart, num, fullSd);
+          PrintfToLog("Best at %s %d  num %d  fullSd %.2f", cand < mNumYholes ?
+            "rowStart" : "colStart", cand < mNumYholes ? 1 - mNumYholes + cand :
+            1 - mNumXholes + cand - mNumYholes, num, fullSd);
       }
+      mLineCache.insert(candCaches[cand].begin(), candCaches[cand].end());
+      numReused += candReused[cand];
+      numLines += candLines[cand];
     }
+    delete[] candArrays;
+    delete[] candCaches;
+    mPrevLineCache.clear();
+    SEMTrace('C', "Evaluated %d box arrangements in %.1f ms with %d threads, reused %d "
+      "of %d lines", numCands, 1000. * (wallTime() - searchStart), passThreads,
+      numReused, numLines);
 
     // Big loop on points
     for (point = 0; point < numPoints; point++) {
@@ -1113,11 +1195,27 @@ int CMultiHoleCombiner::CombineItems(int boundType, BOOL turnOffOutside, int inX
   } else {
 
     // CROSSES
-    // Actually not so hard, try 5 origin positions in each of two directions
-    for (xDir = -1; xDir <= 1; xDir += 2) {
-      for (ori = 0; ori < 5; ori++) {
+    // Actually not so hard, try 5 origin positions in each of two directions, evaluating
+    // these in parallel, and again serially if checking
+    numCands = 10;
+    candSds.resize(numCands);
+    numThreads = NumCombineThreads(numCands);
+    for (pass = 0; pass < (mCheckSerialEval ? 2 : 1); pass++) {
+      if (pass) {
+        parArrays = candArrays;
+        parSds = candSds;
+        parMsec = 1000. * (wallTime() - searchStart);
+      }
+      searchStart = wallTime();
+      candArrays = new PositionArray[numCands];
+      passThreads = pass ? 1 : numThreads;
+#pragma omp parallel for num_threads(passThreads) \
+  shared(numCands, candArrays, candSds, crossDx, crossDy) \
+  private(cand, xDir, ori, ix, iy, dx, dy, vecn, vecm, data, peakVals)
+      for (cand = 0; cand < numCands; cand++) {
+        xDir = cand < 5 ? -1 : 1;
+        ori = cand % 5;
         //PrintfToLog("dir %d Origin %d %d", xDir, crossDy[ori], crossDy[ori]);
-        fullArray.RemoveAll();
         peakVals.clear();
         for (iy = -2; iy <= mNyGrid + 2; iy++) {
           for (ix = -2; ix <= mNxGrid + 2; ix++) {
@@ -1135,24 +1233,38 @@ int CMultiHoleCombiner::CombineItems(int boundType, BOOL turnOffOutside, int inX
               // to the origin
               EvaluateCrossAtPosition(ix, iy, data);
               if (data.numAcquires > 0) {
-                fullArray.Add(data);
+                candArrays[cand].Add(data);
                 peakVals.push_back((float)data.numAcquires);
               }
               //PrintfToLog("legal %d %d  n %d", ix, iy, data.numAcquires);
             }
           }
         }
+        candSds[cand] = 0.;
+        if (peakVals.size())
+          avgSD(&peakVals[0], (int)peakVals.size(), &dx, &candSds[cand], &dy);
+      }
+    }
+    if (parArrays) {
+      CompareSerialEvaluation("cross", numCands, parArrays, parSds, candArrays, candSds,
+        numThreads, parMsec, 1000. * (wallTime() - searchStart));
+      delete[] parArrays;
+      parArrays = NULL;
+    }
 
-        // Keep track of best one
-        num = (int)fullArray.GetSize();
-        avgSD(&peakVals[0], num, &dx, &fullSd, &dy);
-        if (num < minFullNum || (num == minFullNum && fullSd < fullBestSd)) {
-          minFullNum = num;
-          fullBestSd = fullSd;
-          bestFullArray.Copy(fullArray);
-        }
+    // Keep track of best one
+    for (cand = 0; cand < numCands; cand++) {
+      num = (int)candArrays[cand].GetSize();
+      fullSd = candSds[cand];
+      if (num < minFullNum || (num == minFullNum && fullSd < fullBestSd)) {
+        minFullNum = num;
+        fullBestSd = fullSd;
+        bestFullArray.Copy(candArrays[cand]);
       }
     }
+    delete[] candArrays;
+    SEMTrace('C', "Evaluated %d cross arrangements in %.1f ms with %d threads", numCands,
+      1000. * (wallTime() - searchStart), passThreads);
 
     // Process points in the best arrangement
     for (point = 0; point < numPoints; point++) {
@@ -1417,15 +1529,85 @@ bool CMultiHoleCombiner::IsItemInUndoList(int mapID)
   return mSetOfUndoIDs.count(mapID) > 0;
 }
 
-// For one line (a row or a column) find the best arrangement of boxes along that line
+// Get the number of threads for evaluating the given number of candidate arrangements;
+// just one if debug output is on, since that goes to the log
+int CMultiHoleCombiner::NumCombineThreads(int numCands)
+{
+  int numThreads = numCands;
+  B3DCLAMP(numThreads, 1, MAX_COMBINE_THREADS);
+  if (mDebug)
+    numThreads = 1;
+  return numOMPthreads(numThreads);
+}
+
+// Compare the candidate arrangements and SDs from parallel and serial evaluations and
+// report whether they match, along with the time taken by each
+void CMultiHoleCombiner::CompareSerialEvaluation(const char *kind, int numCands,
+  PositionArray *parArrays, FloatVec &parSds, PositionArray *serArrays, FloatVec &serSds,
+  int numThreads, double parMsec, double serMsec)
+{
+  int cand, numDiff = 0;
+  for (cand = 0; cand < numCands; cand++) {
+    if (parArrays[cand].GetSize() != serArrays[cand].GetSize() ||
+      parSds[cand] != serSds[cand] || (parArrays[cand].GetSize() > 0 &&
+        memcmp(parArrays[cand].GetData(), serArrays[cand].GetData(),
+          parArrays[cand].GetSize() * sizeof(PositionData)) != 0))
+      numDiff++;
+  }
+  PrintfToLog("%d %s arrangements: %.1f ms with %d threads, %.1f ms serially; %s",
+    numCands, kind, parMsec, numThreads, serMsec, numDiff ?
+    "RESULTS DIFFER" : "results are identical");
+  if (numDiff)
+    PrintfToLog("   %d of the arrangements differ between parallel and serial "
+      "evaluation", numDiff);
+}
+
+// Make a key for the cache of best lines of boxes from the sizes, the line start and
+// direction, and the occupancy of the grid in the band covered by the line
+void CMultiHoleCombiner::MakeBoxLineKey(int otherStart, bool doCol, std::string &key)
+{
+  char buf[80];
+  int ix, iy;
+  int numAcross = doCol ? mNumXholes : mNumYholes;
+  sprintf_s(buf, 80, "%d %d %d %d %d %d:", doCol ? 1 : 0, otherStart, mNxGrid, mNyGrid,
+    mNumXholes, mNumYholes);
+  key = buf;
+  if (doCol) {
+    for (iy = 0; iy < mNyGrid; iy++)
+      for (ix = B3DMAX(otherStart, 0); ix < B3DMIN(otherStart + numAcross, mNxGrid);
+        ix++)
+        key += mGrid[iy][ix] >= 0 ? '1' : '0';
+  } else {
+    for (iy = B3DMAX(otherStart, 0); iy < B3DMIN(otherStart + numAcross, mNyGrid); iy++)
+      for (ix = 0; ix < mNxGrid; ix++)
+        key += mGrid[iy][ix] >= 0 ? '1' : '0';
+  }
+}
+
+// For one line (a row or a column) find the best arrangement of boxes along that line,
+// or take it from the cache of the last run if the line is unchanged.  The result is
+// added to the new cache and numReused is incremented if it came from the old one
 void CMultiHoleCombiner::TryBoxStartsOnLine(int otherStart, bool doCol,
-  CArray<PositionData, PositionData> &fullArray)
+  CArray<PositionData, PositionData> &fullArray, BoxLineCache &newCache, int &numReused)
 {
   CArray<PositionData, PositionData> bestLineArray[2], lineArray;
   int num, cenMissing, minNum[2] = {10000000, 10000000};
   float sdOfLine, sdAtBest[2];
   int vStart = 1 - (doCol ? mNumYholes : mNumXholes);
-  int bestv;
+  int bestv, best;
+  std::string key;
+  std::vector<PositionData> *cached;
+  BoxLineCache::iterator iter;
+
+  MakeBoxLineKey(otherStart, doCol, key);
+  iter = mPrevLineCache.find(key);
+  if (iter != mPrevLineCache.end()) {
+    for (num = 0; num < (int)iter->second.size(); num++)
+      fullArray.Add(iter->second[num]);
+    newCache[key] = iter->second;
+    numReused++;
+    return;
+  }
 
   // Try possible starts for the line of boxes at the otherStart
   for (; vStart <= 0; vStart++) {
@@ -1441,8 +1623,12 @@ void CMultiHoleCombiner::TryBoxStartsOnLine(int otherStart, bool doCol,
     }
   }
 
-  // Add best one to the full array
-  fullArray.Append(bestLineArray[minNum[0] < 1000 ? 0 : 1]);
+  // Add best one to the full array and save it in the cache
+  best = minNum[0] < 1000 ? 0 : 1;
+  fullArray.Append(bestLineArray[best]);
+  cached = &newCache[key];
+  for (num = 0; num < (int)bestLineArray[best].GetSize(); num++)
+    cached->push_back(bestLineArray[best][num]);
   if (mDebug)
     PrintfToLog("Best start for %d at %d", otherStart, bestv);
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <set>
+#include <map>
+#include <string>
 
 class CMapDrawItem;
 class HoleFinder;
@@ -19,6 +21,9 @@ struct PositionData
   short cenMissing;
 };
 
+typedef CArray<PositionData, PositionData> PositionArray;
+typedef std::map<std::string, std::vector<PositionData> > BoxLineCache;
+
 class CMultiHoleCombiner
 {
 public:
@@ -34,6 +39,7 @@ public:
   const char *GetErrorMessage(int error);
   MapItemArray *GetPreCombineHoles() { return &mPreCombineHoles; };
   void ClearSavedItemArray(bool originalToo, bool updateDlg);
+  GetSetMember(bool, CheckSerialEval);
 
 private:
   CNavHelper *mHelper;
@@ -63,9 +69,17 @@ private:
   int mNumRings;                  // Number of rings in hex pattern
   IntVec mHexToItemIndex;         // Map from hex number to item number as array is built
   int mDebug;
+  BoxLineCache mLineCache;        // Best box lines from the last run, keyed by occupancy
+  BoxLineCache mPrevLineCache;    // Cache from previous run while new one is built
+  bool mCheckSerialEval;          // Repeat evaluation of candidates serially and compare
 
   void TryBoxStartsOnLine(int otherStart, bool doCol,
-    CArray<PositionData, PositionData> &fullArray);
+    CArray<PositionData, PositionData> &fullArray, BoxLineCache &newCache, int &numReused);
+  void MakeBoxLineKey(int otherStart, bool doCol, std::string &key);
+  int NumCombineThreads(int numCands);
+  void CompareSerialEvaluation(const char *kind, int numCands, PositionArray *parArrays,
+    FloatVec &parSds, PositionArray *serArrays, FloatVec &serSds, int numThreads,
+    double parMsec, double serMsec);
   void EvaluateLineOfBoxes(int xStart, int yStart, bool doCol,
     CArray<PositionData, PositionData> &posArray, float &sdOfNums, int &cenMissing);
   void EvaluateBoxAtPosition(int xStart, int yStart, PositionData &data);
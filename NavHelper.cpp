@@ -6598,6 +6598,7 @@ int CNavHelper::AlignWithRotation(int buffer, float centerAngle, float angleRang
   float *CCCp = &CCC, *fracPixP = &fracPix;
   double overlapPow = 0.166667;
   int smallPad = shiftLimit > 0 ? 1 : 0;
+  double startTime = GetTickCount();
   FloatVec vecRot, vecPeak;
   CString report;
 
@@ -6614,6 +6615,9 @@ int CNavHelper::AlignWithRotation(int buffer, float centerAngle, float angleRang
       " of rotation alignment");
     return 4;
   }
+
+  // The reference is the same for all rotations, so keep its filtered spectrum
+  mShiftManager->SetKeepRefSpectrum(true);
   if (doPart > 1) {
     numSteps = 3;
     angleRange = 3 * step;
@@ -6633,6 +6637,7 @@ int CNavHelper::AlignWithRotation(int buffer, float centerAngle, float angleRang
         0., 0., 0., scaling, rotation, CCCp, fracPixP, true, &shiftX, &shiftY)) {
         if (shiftLimit > 0)
           continue;
+        StopRotationSearch(startTime);
         return 3;
       }
       if (CCCp)
@@ -6653,18 +6658,23 @@ int CNavHelper::AlignWithRotation(int buffer, float centerAngle, float angleRang
   if (istMax < 0) {
     mWinApp->AppendToLog("No correlation peak was found within the limits for any "
       "rotation tested");
+    StopRotationSearch(startTime);
     return 2;
   }
   if (numSteps > 2 && (istMax == 0 || istMax == numSteps - 1)) {
     mWinApp->AppendToLog("The best correlation was found at the end of the range tested;"
     "\r\nyou should redo this with a different angular range");
-    if (CCCp)
+    if (CCCp) {
+      StopRotationSearch(startTime);
       return 1;
+    }
   }
   if (maxPtr)
     *maxPtr = peakmax;
-  if (doPart == 1)
+  if (doPart == 1) {
+    StopRotationSearch(startTime);
     return 0;
+  }
 
   // Cut the step and look on either side of the peak
   if (numSteps > 2 && !(istMax == 0 || istMax == numSteps - 1) && doPart >= 0) {
@@ -6681,6 +6691,7 @@ int CNavHelper::AlignWithRotation(int buffer, float centerAngle, float angleRang
           0., 0., 0., scaling, rotation, CCCp, fracPixP, true, &shiftX, &shiftY)) {
           if (shiftLimit > 0)
             continue;
+          StopRotationSearch(startTime);
           return 3;
         }
         if (CCCp)
@@ -6702,6 +6713,8 @@ int CNavHelper::AlignWithRotation(int buffer, float centerAngle, float angleRang
     }
   }
 
+  StopRotationSearch(startTime);
+
   // Get interpolated value
   UtilInterpolatePeak(vecRot, vecPeak, step, peakmax, rotBest);
 
@@ -6712,6 +6725,13 @@ int CNavHelper::AlignWithRotation(int buffer, float centerAngle, float angleRang
   return 0;
 }
 
+// Stop keeping the reference spectrum at the end of a rotation search and report time
+void CNavHelper::StopRotationSearch(double startTime)
+{
+  mShiftManager->SetKeepRefSpectrum(false);
+  SEMTrace('p', "Rotation search took %.0f msec", SEMTickInterval(startTime));
+}
+
 // Top-level call for aligning with both scaling and rotation
 int CNavHelper::AlignWithScaleAndRotation(int buffer, bool doImShift, float scaleRange,
   float angleRange, float &scaleMax, float &rotation, float shiftLimit, int corrFlags)
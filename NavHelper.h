@@ -771,6 +771,7 @@ public:
   int AlignWithRotation(int buffer, float centerAngle, float angleRange,
     float &rotBest, float &shiftXbest, float &shiftYbest, float scaling = 0., int doPart = 0,
     float *maxPtr = NULL, float shiftLimit = -1.f, int corrFlags = 0);
+  void StopRotationSearch(double startTime);
   int AlignWithScaleAndRotation(int buffer, bool doImshift, float scaleRange, float angleRange,
     float &scaleMax, float &rotation, float shiftLimit, int corrFlags); 
   int OKtoAlignWithRotation(void);
@@ -77,6 +77,19 @@ static char *typeString[] = {"Pt", "Poly", "Map", "Imp", "Anc"};
 #define NAV_FILE_VERSION "2.00"
 #define VERSION_TIMES_100 200
 
+// Number of items between checks for messages and stop when loading; interval for
+// showing loaded items, and minimum loading time for reporting the rate in the log
+#define NAV_LOAD_CHECK_ITEMS 100
+#define NAV_LOAD_PUBLISH_MSEC 1000
+#define NAV_LOAD_REPORT_MSEC 3000
+
+// Data for the thread that reads a Nav file as an autodoc
+struct NavReadThreadData {
+  CString filename;
+  int adocIndex;
+};
+static NavReadThreadData sNavReadTD;
+
 
 // Simple derived drag list box class for notifying of a drag change
 CMyDragListBox::CMyDragListBox()
@@ -85,25 +98,52 @@ CMyDragListBox::CMyDragListBox()
 }
 
 // Selection change and clicking in empty space both generate this message, so
-// make sure it is legal new index
+// make sure it is legal new index.  The base class can't move strings in a list with no
+// data, so this does its test for whether there was a move and leaves the rest to the
+// Navigator.  Since it does a remove then insert, index needs to be reduced for a higher
+// new value (a difference of 1 does nothing)
 void CMyDragListBox::Dropped( int nSrcIndex, CPoint pt )
 {
-  CDragListBox::Dropped(nSrcIndex, pt);
-  int newIndex = GetCurSel();
-  if (newIndex == LB_ERR) {
-
-    // This is the old way which was flawed when there was a scrolling change in the drop
-    // Since we do a remove then insert below, index needs to be reduced for a higher
-    // new value (a difference of 1 does nothing)
-    newIndex = ItemFromPt(pt);
-    if (newIndex > nSrcIndex)
-     newIndex--;
-  }
+  DrawInsert(-1);
+  int newIndex = ItemFromPt(pt);
+  if (nSrcIndex < 0 || newIndex < 0 || newIndex == nSrcIndex + 1)
+    return;
+  if (newIndex > nSrcIndex)
+    newIndex--;
 
-  if (newIndex >= 0 && nSrcIndex != newIndex)
+  if (nSrcIndex != newIndex)
     ((CSerialEMApp *)AfxGetApp())->mNavigator->OnListItemDrag(nSrcIndex, newIndex);
 }
 
+// Draw one row, getting the string from the Navigator's cache
+void CMyDragListBox::DrawItem(LPDRAWITEMSTRUCT lpDIS)
+{
+  CNavigatorDlg *nav = ((CSerialEMApp *)AfxGetApp())->mNavigator;
+  CDC *pDC = CDC::FromHandle(lpDIS->hDC);
+  CRect rect = lpDIS->rcItem;
+  CString string;
+  CFont *oldFont;
+  int numTabs, *tabs;
+  bool selected = (lpDIS->itemState & ODS_SELECTED) != 0;
+  bool newString;
+  if (!nav || (int)lpDIS->itemID < 0)
+    return;
+  if (lpDIS->itemAction & (ODA_DRAWENTIRE | ODA_SELECT)) {
+    newString = nav->GetListRowString((int)lpDIS->itemID, string);
+    tabs = nav->GetListTabStops(numTabs);
+    oldFont = pDC->SelectObject(GetFont());
+    pDC->FillSolidRect(&rect, GetSysColor(selected ? COLOR_HIGHLIGHT : COLOR_WINDOW));
+    pDC->SetTextColor(GetSysColor(selected ? COLOR_HIGHLIGHTTEXT : COLOR_WINDOWTEXT));
+    pDC->SetBkMode(TRANSPARENT);
+    pDC->TabbedTextOut(rect.left + 1, rect.top, string, numTabs, tabs, rect.left + 1);
+    if (newString)
+      nav->NoteListRowExtent(pDC->GetTabbedTextExtent(string, numTabs, tabs).cx + 2);
+    pDC->SelectObject(oldFont);
+  }
+  if ((lpDIS->itemAction & ODA_FOCUS) || (lpDIS->itemState & ODS_FOCUS))
+    pDC->DrawFocusRect(&rect);
+}
+
 
 /////////////////////////////////////////////////////////////////////////////
 // CNavigatorDlg dialog
@@ -142,6 +182,8 @@ CNavigatorDlg::CNavigatorDlg(CWnd* pParent /*=NULL*/)
   mInitialized = false;
   mNonModal = true;
   mNumDigitsForIndex = -1;
+  mListMaxExtent = 0;
+  mNumListTabs = 0;
   mItemArray.SetSize(0, 5);
   mGroupFiles.SetSize(0, 4);
   mFileOptArray.SetSize(0, 4);
@@ -164,6 +206,9 @@ CNavigatorDlg::CNavigatorDlg(CWnd* pParent /*=NULL*/)
   mMontItem = NULL;
   mMarkerShiftReg = 0;
   mLoadingMap = false;
+  mLoadingNavFile = false;
+  mStopLoadingNav = false;
+  mNavReadThread = NULL;
   mShiftAIndex = -1;
   mShiftDIndex = -1;
   mShiftTIndex = -1;
@@ -377,6 +422,15 @@ BOOL CNavigatorDlg::OnInitDialog()
   m_listViewer.GetWindowRect(editRect);
   mListBorderX = clientRect.Width() - editRect.Width();
   mListBorderY = clientRect.Height() - editRect.Height();
+
+  // The list is owner-drawn with no data, so set its row height from the font
+  TEXTMETRIC metrics;
+  CDC *pDC = m_listViewer.GetDC();
+  CFont *oldFont = pDC->SelectObject(m_listViewer.GetFont());
+  pDC->GetTextMetrics(&metrics);
+  pDC->SelectObject(oldFont);
+  m_listViewer.ReleaseDC(pDC);
+  m_listViewer.SetItemHeight(0, metrics.tmHeight);
   m_statListHeader.GetWindowRect(editRect);
   mHeaderBorderX = clientRect.Width() - editRect.Width();
   mHeaderHeight = editRect.Height();
@@ -470,8 +524,15 @@ void CNavigatorDlg::PostNcDestroy()
 // This override takes care of the closing situation, OnClose is redundant
 void CNavigatorDlg::OnCancel()
 {
-  if (!OKtoCloseNav())
+  if (!OKtoCloseNav()) {
+
+    // If items or maps are still being loaded, stop that and let them close later
+    if (mLoadingNavFile)
+      mStopLoadingNav = true;
+    if (mWinApp->mMultiGridTasks->GetLoadingAllMaps())
+      mWinApp->mMultiGridTasks->SetStopLoadingMaps(true);
     return;
+  }
   if (AskIfSave("closing window?"))
     return;
   mHelper->SetCollapseGroups(m_bCollapseGroups);
@@ -495,7 +556,8 @@ BOOL CNavigatorDlg::OnHelpInfo(HELPINFO * lpHelpInfo)
 // Central place to test for whether it is OK to close the dialog
 bool CNavigatorDlg::OKtoCloseNav()
 {
-  return !(mLoadingMap || mAcquireIndex >= 0 ||
+  return !(mLoadingMap || mLoadingNavFile || mAcquireIndex >= 0 ||
+    mWinApp->mMultiGridTasks->GetLoadingAllMaps() ||
     mWinApp->mMultiGridTasks->GetDoingMulGridSeq() ||
     mWinApp->mMultiGridTasks->GetDoingMultiGrid());
 }
@@ -1922,8 +1984,12 @@ void CNavigatorDlg::OnListItemDrag(int oldIndex, int newIndex)
     m_strItemNum.Format("# %d", mCurrentItem + 1);
   mSelectedItems.clear();
   mSelectedItems.insert(mCurrentItem);
-  if (m_bTableIndexes)
+  if (m_bTableIndexes) {
     FillListBox(true, true);
+  } else {
+    for (i = B3DMIN(oldIndex, newIndex); i <= B3DMAX(oldIndex, newIndex); i++)
+      InvalidateListRow(i);
+  }
   if (mHelper->GetParTSSetupGroupID() > 0)
     Redraw();
   UpdateData(false);
@@ -2405,7 +2471,6 @@ void CNavigatorDlg::NewFileRangeNextTask(int synchronous)
 // Construct list box string for the given item
 void CNavigatorDlg::ItemToListString(int index, CString &string)
 {
-  CDC *pDC = m_listViewer.GetDC();
   CString substr;
   CMapDrawItem *item2;
   ScheduledFile *sched = NULL;
@@ -2482,23 +2547,85 @@ void CNavigatorDlg::ItemToListString(int index, CString &string)
       string += "P";
     string += CString(item->mCorner ? "C\t" : "\t") + item->mNote;
   }
-  item->mTextExtent = (pDC->GetTextExtent(string)).cx;
-  m_listViewer.ReleaseDC(pDC);
 }
 
-// Get a new string for the given item and replace it in list box
+// Mark the string for the given item as needing to be remade; it will be redrawn if it
+// is visible
 void CNavigatorDlg::UpdateListString(int index)
 {
-  CString string;
   if (mMacroProcessor->DoingMacro() && mMacroProcessor->GetSuspendNavRedraw())
     return;
-  ItemToListString(index, string);
   if (m_bCollapseGroups)
     index = mItemToList[index];
-  m_listViewer.DeleteString(index);
-  m_listViewer.InsertString(index, string);
-  if (mCurListSel >= 0)
-    m_listViewer.SetCurSel(mCurListSel);
+  InvalidateListRow(index);
+}
+
+// Get the string for a row of the list box, making it if it is not in the cache.
+// Returns true if it was made
+bool CNavigatorDlg::GetListRowString(int row, CString &string)
+{
+  int index = row;
+  string = "";
+  if (row < 0 || row >= (int)mListRowStrings.size())
+    return false;
+  if (!mListRowStrings[row].IsEmpty()) {
+    string = mListRowStrings[row];
+    return false;
+  }
+  if (m_bCollapseGroups) {
+    if (row >= (int)mListToItem.size())
+      return false;
+    index = mListToItem[row];
+    if (index < 0)
+      index = -1 - index;
+  }
+  if (index >= mItemArray.GetSize())
+    return false;
+  ItemToListString(index, mListRowStrings[row]);
+  string = mListRowStrings[row];
+  return true;
+}
+
+// Clear the cached string for a row and have it redrawn
+void CNavigatorDlg::InvalidateListRow(int row)
+{
+  CRect rect;
+  if (row < 0 || row >= (int)mListRowStrings.size())
+    return;
+  mListRowStrings[row].Empty();
+  if (m_listViewer.GetItemRect(row, &rect) != LB_ERR)
+    m_listViewer.InvalidateRect(&rect, FALSE);
+}
+
+// Insert rows at the given row for a positive numChange or delete rows starting there for
+// a negative one, keeping the same rows at the top.  If indexes are shown, all following
+// strings need to be remade
+void CNavigatorDlg::ResizeListRows(int row, int numChange)
+{
+  int top = m_listViewer.GetTopIndex();
+  int num = (int)mListRowStrings.size();
+  B3DCLAMP(row, 0, num);
+  if (numChange > 0) {
+    mListRowStrings.insert(mListRowStrings.begin() + row, numChange, CString());
+  } else if (numChange < 0) {
+    numChange = B3DMIN(-numChange, num - row);
+    mListRowStrings.erase(mListRowStrings.begin() + row,
+      mListRowStrings.begin() + row + numChange);
+  }
+  if (m_bTableIndexes)
+    for (num = row; num < (int)mListRowStrings.size(); num++)
+      mListRowStrings[num].Empty();
+  m_listViewer.SetCount((int)mListRowStrings.size());
+  if (top > 0)
+    m_listViewer.SetTopIndex(B3DMIN(top, (int)mListRowStrings.size() - 1));
+}
+
+// Keep track of the longest row drawn and increase the scrolling extent if needed
+void CNavigatorDlg::NoteListRowExtent(int extent)
+{
+  if (extent <= mListMaxExtent)
+    return;
+  mListMaxExtent = extent;
   ManageListScroll();
 }
 
@@ -2520,13 +2647,15 @@ void CNavigatorDlg::UpdateGroupStrings(int groupID)
   }
 }
 
-// Fill the list box with all of the items in the array
+// Fill the list box with all of the items in the array; strings are made only when rows
+// are drawn
 // Skip managing current controls by default, reset selection to 0
 void CNavigatorDlg::FillListBox(bool skipManage, bool keepSel)
 {
   CString string;
   HDWP positions;
-  int lim, offset = 0, updated = -1;
+  CRect rect;
+  int lim, offset = 0;
   int numDig = 0, noIndex = m_bTableIndexes ? 0 : 1, i = (int)mItemArray.GetSize();
 
   // label, color, X, Y, Z, type, reg, corner, extras
@@ -2534,7 +2663,9 @@ void CNavigatorDlg::FillListBox(bool skipManage, bool keepSel)
   int fields[numTabs] = {0,37,16,25,25,21,15,19,15,8,8};
   int tabs[numTabs];
 
-  m_listViewer.ResetContent();
+  mListRowStrings.clear();
+  mListMaxExtent = 0;
+  m_listViewer.SetCount(0);
 
   // Find number of digits to display
   if (m_bTableIndexes) {
@@ -2558,8 +2689,13 @@ void CNavigatorDlg::FillListBox(bool skipManage, bool keepSel)
     for (i = 1; i < numTabs - noIndex; i++)
       tabs[i] = tabs[i - 1] + fields[i + noIndex];
 
-    // Set the tab stops and shift the column labels
-    m_listViewer.SetTabStops(numTabs - noIndex, tabs);
+    // Set the tab stops in pixels for drawing and shift the column labels
+    mNumListTabs = numTabs - noIndex;
+    for (i = 0; i < mNumListTabs; i++) {
+      rect.SetRect(tabs[i], 0, 0, 0);
+      MapDialogRect(&rect);
+      mListTabPixels[i] = rect.left;
+    }
     positions = BeginDeferWindowPos(9);
     if (positions) {
       for (i = 0; i < 9; i++) {
@@ -2573,22 +2709,16 @@ void CNavigatorDlg::FillListBox(bool skipManage, bool keepSel)
     }
   }
 
-  // Fill the table with new list strings
+  // Set the number of rows in the table
   if (mItemArray.GetSize()) {
-    for (i = 0; i < mItemArray.GetSize(); i++) {
-      if (!m_bCollapseGroups || mItemToList[i] != updated) {
-        ItemToListString(i, string);
-        m_listViewer.AddString(string);
-        if (m_bCollapseGroups)
-          updated = mItemToList[i];
-      }
-    }
+    lim = (int)(m_bCollapseGroups ? mListToItem.size() : mItemArray.GetSize());
+    mListRowStrings.resize(lim);
+    m_listViewer.SetCount(lim);
     if (!keepSel) {
       mCurrentItem = 0;
       mCurListSel = 0;
     } else {
-      lim = (int)(m_bCollapseGroups ? mListToItem.size() : mItemArray.GetSize()) - 1;
-      B3DCLAMP(mCurListSel, 0, lim);
+      B3DCLAMP(mCurListSel, 0, lim - 1);
     }
     m_listViewer.SetCurSel(mCurListSel);
     ManageListScroll();
@@ -2600,18 +2730,10 @@ void CNavigatorDlg::FillListBox(bool skipManage, bool keepSel)
     ManageCurrentControls();
 }
 
-// Determine maximum length of list strings and set extent for slider to work
+// Set extent for slider to work from maximum length of list strings drawn so far
 void CNavigatorDlg::ManageListScroll()
 {
-  int i;
-  int xmax = 0;
-  CMapDrawItem *item;
-  for (i = 0; i < mItemArray.GetSize(); i++) {
-    item = mItemArray[i];
-    if (xmax < item->mTextExtent)
-      xmax = item->mTextExtent;
-  }
-  m_listViewer.SetHorizontalExtent(xmax);
+  m_listViewer.SetHorizontalExtent(mListMaxExtent);
 }
 
 // Pad a number so that it is less than the given maximum length by 2 spaces
@@ -6620,8 +6742,7 @@ int CNavigatorDlg::MakeGridOrFoundPoints(int jstart, int jend, int jdir, int kst
         mCurListSel = curSelBefore;
         mCurrentItem = curItemBefore;
         firstCurItem = -1;
-        for (k = m_listViewer.GetCount() - 1; k >= numListStrBefore; k--)
-          m_listViewer.DeleteString(k);
+        ResizeListRows(numListStrBefore, numListStrBefore - m_listViewer.GetCount());
         m_listViewer.SetCurSel(mCurListSel);
         MakeListMappings();
         retval = 0;
@@ -8597,7 +8718,7 @@ int CNavigatorDlg::AskIfSave(CString reason)
 // Do autosave if file is open, and things have changed
 void CNavigatorDlg::AutoSave()
 {
-  if (!mChanged)
+  if (!mChanged || mLoadingNavFile)
     return;
   if (!mNavFilename.IsEmpty())
     DoSave(true);
@@ -9064,6 +9185,9 @@ int CNavigatorDlg::LoadNavFile(bool checkAutosave, bool mergeFile, CString *inFi
   const int maxFvals = 1000;
   BOOL found;
   int numSect, numAdocErr, numLackRequired, sectInd = 0, adocIndex = -1;
+  int numRead = 0, numLoaded, numTotal;
+  double loadStart, lastPublish;
+  bool stopped = false;
   int numToGet, numItemLack = 0, numItemErr = 0, numExtErr = 0;
   int extErrCounts[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
   const char *extErrMess[16] = {
@@ -9158,14 +9282,23 @@ int CNavigatorDlg::LoadNavFile(bool checkAutosave, bool mergeFile, CString *inFi
           "could not be acquired", MB_EXCLAME);
         return 1;
       }
-      adocIndex = AdocRead((LPCTSTR)name);
-      if (adocIndex < 0) {
-
-        str = "An error occurred reading in the Navigator file as an autodoc";
-        if (b3dGetError())
-          str += CString(":\n") + b3dGetError();
-        SEMMessageBox(str, MB_EXCLAME);
+      adocIndex = ReadNavAdocInThread(name);
+      if (adocIndex < 0 || mStopLoadingNav) {
+        if (adocIndex >= 0) {
+          AdocClear(adocIndex);
+          mWinApp->AppendToLog("Loading of Navigator file stopped");
+        } else {
+          str = "An error occurred reading in the Navigator file as an autodoc";
+          if (b3dGetError())
+            str += CString(":\n") + b3dGetError();
+          SEMMessageBox(str, MB_EXCLAME);
+        }
         AdocReleaseMutex();
+        mStopLoadingNav = false;
+        if (!mergeFile) {
+          mNavFilename = "";
+          SetWindowText("Navigator");
+        }
         return 1;
       }
       if (!AdocGetString(ADOC_GLOBAL_NAME, 0, "LastSavedAs", &adocStr) && adocStr) {
@@ -9557,9 +9690,28 @@ int CNavigatorDlg::LoadNavFile(bool checkAutosave, bool mergeFile, CString *inFi
 #undef FIND_DUP_OR_ADD
     }
 
-    // Loop on entries in either case
+    // Loop on entries in either case, keeping the interface active and allowing a stop
+    mLoadingNavFile = true;
+    mStopLoadingNav = false;
+    mWinApp->UpdateBufferWindows();
+    loadStart = lastPublish = GetTickCount();
+    numTotal = adocIndex >= 0 ? numSect : 0;
     for (;;) {
       numAdocErr = numLackRequired = numExternal = externalErr = 0;
+      if (numRead > 0 && !(numRead % NAV_LOAD_CHECK_ITEMS)) {
+        if (SEMTickInterval(lastPublish) > NAV_LOAD_PUBLISH_MSEC) {
+          PublishLoadedItems(numRead, numTotal, mergeFile);
+          lastPublish = GetTickCount();
+        }
+        SleepMsg(1);
+        if (adocIndex >= 0)
+          AdocSetCurrent(adocIndex);
+        if (mStopLoadingNav) {
+          stopped = true;
+          break;
+        }
+      }
+      numRead++;
       if (adocIndex >= 0) {
 
         // Fetch values from autodoc until # of items satisfied
@@ -10161,6 +10313,31 @@ int CNavigatorDlg::LoadNavFile(bool checkAutosave, bool mergeFile, CString *inFi
     delete cFile;
   }
   mHelper->CleanupFromExternalFileAccess();
+  mLoadingNavFile = false;
+  mStopLoadingNav = false;
+  mWinApp->SetStatusText(MEDIUM_PANE, "");
+  mWinApp->UpdateBufferWindows();
+
+  // Report the loading rate for a big file
+  numLoaded = (int)mItemArray.GetSize() - (mergeFile ? originalSize : 0);
+  if (!returnVal && (SEMTickInterval(loadStart) > NAV_LOAD_REPORT_MSEC ||
+    GetDebugOutput('n')))
+    PrintfToLog("Loaded %d Navigator items in %.2f sec (%.0f items/sec)", numLoaded,
+      SEMTickInterval(loadStart) / 1000., numLoaded * 1000. /
+      B3DMAX(1., SEMTickInterval(loadStart)));
+  if (stopped) {
+
+    // Drop the file name so that a save cannot overwrite the full file with a partial one
+    str.Format("Loading of the Navigator file was stopped after %d items were read.\n\n"
+      "Saving the Navigator file now will leave out the remaining items.", numRead);
+    if (!mergeFile) {
+      mNavFilename = "";
+      SetWindowText("Navigator");
+      str += "\nThe file name has been cleared so that you must save to a new file.";
+    }
+    SEMMessageBox(str, MB_EXCLAME);
+    returnVal = 1;
+  }
 
   // Give error summaries
   if (numItemErr + numItemLack + numExtErr > 0) {
@@ -10238,6 +10415,67 @@ int CNavigatorDlg::LoadNavFile(bool checkAutosave, bool mergeFile, CString *inFi
   return returnVal;
 }
 
+// Read the Nav file as an autodoc in a thread so that the interface stays active for a
+// big file.  The autodoc mutex must be held already.  Returns the autodoc index, or -1
+// for an error
+int CNavigatorDlg::ReadNavAdocInThread(CString &name)
+{
+  int busy;
+  double startTime = GetTickCount();
+  sNavReadTD.filename = name;
+  sNavReadTD.adocIndex = -1;
+  mLoadingNavFile = true;
+  mStopLoadingNav = false;
+  mNavReadThread = AfxBeginThread(NavAdocReadProc, &sNavReadTD, THREAD_PRIORITY_NORMAL,
+    0, CREATE_SUSPENDED);
+  mNavReadThread->m_bAutoDelete = false;
+  mNavReadThread->ResumeThread();
+  mWinApp->UpdateBufferWindows();
+  mWinApp->SetStatusText(MEDIUM_PANE, "READING NAV FILE");
+
+  // Wait until done
+  while (1) {
+    busy = UtilThreadBusy(&mNavReadThread);
+    if (busy <= 0)
+      break;
+    mWinApp->ManageBlinkingPane(GetTickCount());
+    SleepMsg(20);
+  }
+  mLoadingNavFile = false;
+  mWinApp->SetStatusText(MEDIUM_PANE, "");
+  mWinApp->UpdateBufferWindows();
+  if (GetDebugOutput('n'))
+    PrintfToLog("Read Navigator file as autodoc in %.2f sec",
+      SEMTickInterval(startTime) / 1000.);
+  return busy < 0 ? -1 : sNavReadTD.adocIndex;
+}
+
+// The thread procedure for reading the autodoc
+UINT CNavigatorDlg::NavAdocReadProc(LPVOID pParam)
+{
+  NavReadThreadData *td = (NavReadThreadData *)pParam;
+  td->adocIndex = AdocRead((LPCTSTR)td->filename);
+  return td->adocIndex < 0 ? 1 : 0;
+}
+
+// Show the items loaded so far in the list and image and give progress in status bar
+void CNavigatorDlg::PublishLoadedItems(int numLoaded, int numTotal, bool mergeFile)
+{
+  CString str;
+  if (!mergeFile) {
+    mCurrentItem = B3DMIN(B3DMAX(0, mCurrentItem), (int)mItemArray.GetSize() - 1);
+    if (m_bCollapseGroups)
+      MakeListMappings();
+    FillListBox(true, false);
+    Redraw();
+  }
+  if (numTotal > 0)
+    str.Format("LOADING NAV %d/%d", numLoaded, numTotal);
+  else
+    str.Format("LOADING NAV %d", numLoaded);
+  mWinApp->SetStatusText(MEDIUM_PANE, str);
+}
+
 // Finish loading a montage param from Nav file or multigrid session file
 void CNavigatorDlg::FinishMontParamLoad(MontParam *montParam, int ind1, int &numAdocErr)
 {
@@ -12029,6 +12267,7 @@ void CNavigatorDlg::StopAcquiring(BOOL testMacro)
   mFocusCycleCounter = -1;
   mWinApp->mFocusManager->SetTargetDefocus(mSavedTargetDefocus);
   mPausedAcquire = false;
+  mShiftManager->SetKeepRefSpectrum(false);
   ManageListHeader();
   SetCollapsing(mSaveCollapsed);
   mWinApp->UpdateBufferWindows();
@@ -12680,7 +12919,6 @@ void CNavigatorDlg::SetChanged(BOOL inVal)
 // Make a new item and make it current item
 CMapDrawItem *CNavigatorDlg::MakeNewItem(int groupID)
 {
-  CString str;
   CMapDrawItem *item = new CMapDrawItem();
   bool addstr = true;
   CMapDrawItem *lastItem;
@@ -12715,9 +12953,10 @@ CMapDrawItem *CNavigatorDlg::MakeNewItem(int groupID)
 
   if (!(mDeferAddingToViewer || (mMacroProcessor->DoingMacro() &&
     mMacroProcessor->GetSuspendNavRedraw()))) {
-    ItemToListString(mCurrentItem, str);
     if (addstr)
-      m_listViewer.AddString(str);
+      ResizeListRows(m_listViewer.GetCount(), 1);
+    else
+      InvalidateListRow(mCurListSel);
     m_listViewer.SetCurSel(mCurListSel);
   }
   mSelectedItems.clear();
@@ -12758,7 +12997,7 @@ void CNavigatorDlg::FinishSingleDeletion(CMapDrawItem *item, int delIndex, int l
     delIndex = (int)mItemArray.GetSize() - 1;
     item = mItemArray[delIndex];
   } else if (!multipleInGroup) {
-    m_listViewer.DeleteString(listInd);
+    ResizeListRows(listInd, -1);
   }
 
   DeleteAndRemoveFromArray(delIndex);
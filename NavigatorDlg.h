@@ -64,6 +64,7 @@ public:
   CMyDragListBox();
 
   virtual void Dropped( int nSrcIndex, CPoint pt );
+  virtual void DrawItem(LPDRAWITEMSTRUCT lpDIS);
 };
 
 
@@ -111,6 +112,9 @@ public:
   BOOL NoDrawing() {return !(mAddingPoints || mAddingPoly || mMovingItem);};
 	int GetItemType();
   int LoadNavFile(bool checkAutosave, bool mergeFile, CString *inFilename = NULL);
+  int ReadNavAdocInThread(CString &name);
+  static UINT NavAdocReadProc(LPVOID pParam);
+  void PublishLoadedItems(int numLoaded, int numTotal, bool mergeFile);
   void FinishMontParamLoad(MontParam *montParam, int ind1, int &numAdocErr);
 	int SetupMontage(CMapDrawItem *item, CMontageSetupDlg *montDlg, bool skipSetupDlg, 
     float overlapFac = 0., int source = 0);
@@ -148,6 +152,11 @@ public:
 	void FillListBox(bool skipManage = false, bool keepSel = false);
 	void UpdateListString(int index);
 	void ItemToListString(int index, CString &string);
+  bool GetListRowString(int row, CString &string);
+  void InvalidateListRow(int row);
+  void ResizeListRows(int row, int numChange);
+  void NoteListRowExtent(int extent);
+  int *GetListTabStops(int &numTabs) { numTabs = mNumListTabs; return &mListTabPixels[0]; };
 	BOOL UserMousePoint(EMimageBuffer *imBuf, float inX, float inY, BOOL nearCenter, int button);
   bool ConvertMousePoint(EMimageBuffer *imBuf, float &inX, float &inY, float &stageX,
     float &stageY, ScaleMat &aInv, float &delX, float &delY, float &xInPiece, float &yInPiece,
@@ -176,6 +185,8 @@ public:
   void GetLastMarkerShift(float &outX, float &outY) { outX = mMarkerShiftX; outY = mMarkerShiftY; };
   GetMember(int, AcquireEnded)
   GetMember(BOOL, LoadingMap)
+  GetMember(bool, LoadingNavFile);
+  SetMember(bool, StopLoadingNav);
   GetMember(int, NumSavedRegXforms)
   SetMember(int, SuperCoordIndex)
   GetMember(BOOL, StartedTS)
@@ -350,6 +361,10 @@ private:
   int mCurListSel;          // Current list selection in collapsed mode
   std::set<int> mSelectedItems;  // Set of selected items indexes
   int mNumDigitsForIndex;   // Number of digits when showing indexes
+  std::vector<CString> mListRowStrings;  // Cache of strings for rows, empty if not made
+  int mListMaxExtent;       // Maximum extent of rows drawn since list was filled
+  int mListTabPixels[11];   // Tab stops in pixels for drawing rows
+  int mNumListTabs;
   int mRegPointNum;
   int mNewItemNum;
   BOOL mAddingPoints;
@@ -411,6 +426,9 @@ private:
   float mUseWidth, mUseHeight;
   int mOverviewBinSave;
   BOOL mLoadingMap;         // Flag that map is being loaded
+  bool mLoadingNavFile;     // Flag that Nav file is being read, with interface active
+  bool mStopLoadingNav;     // Flag that user pressed STOP during loading
+  CWinThread *mNavReadThread;  // Thread for reading Nav file as autodoc
   int mBufToLoadInto;      // Buffer being loaded to
   int mShowAfterLoad;      // Flag to display after loading map, plus 2 for interactive
   int mShiftAIndex;        // Starting index for doing shift A
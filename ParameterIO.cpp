@@ -61,6 +61,7 @@
 #include "TSVariationsDlg.h"
 #include "PiezoAndPPControl.h"
 #include "ParallelTSDlg.h"
+#include "SimulatedPlugin.h"
 #include "Shared\b3dutil.h"
 #include "Utilities\KGetOne.h"
 #include <set>
@@ -3230,6 +3231,7 @@ int CParameterIO::ReadProperties(CString strFileName)
   CString message;
   CameraParameters *mCamParam = mWinApp->GetCamParams();
   CameraParameters *camP;
+  SimulatorParams *simParams;
   std::map<int, float> *refinedPix = mShiftManager->GetRefinedPixelSizes();
   FileOptions *defFileOpt = mDocWnd->GetDefFileOpt();
   CArray<CString, CString> *globalValues = mDocWnd->GetGlobalAdocValues();
@@ -3947,8 +3949,47 @@ int CParameterIO::ReadProperties(CString strFileName)
         mWinApp->SetKeepSTEMstate(itemInt[1] != 0);
       else if (MatchNoCase("NoCameras"))
         mWinApp->SetNoCameras(itemInt[1] != 0);
+      else if (MatchNoCase("SimulatedScopeAndCamera"))
+        SimPlugGetParams()->enable = itemInt[1];
+      else if (MatchNoCase("SimulatorStageAndCalls")) {
+        simParams = SimPlugGetParams();
+        simParams->stageSpeed = itemFlt[1];
+        if (!itemEmpty[2])
+          simParams->stageSettleMsec = itemFlt[2];
+        if (!itemEmpty[3])
+          simParams->tiltSpeed = itemFlt[3];
+        if (!itemEmpty[4])
+          simParams->scopeCallMsec = itemFlt[4];
+      } else if (MatchNoCase("SimulatorCamera")) {
+        simParams = SimPlugGetParams();
+        simParams->readoutMsec = itemFlt[1];
+        if (!itemEmpty[2])
+          simParams->pixelMicrons = itemFlt[2];
+        if (!itemEmpty[3])
+          simParams->makeTexture = itemInt[3];
+      } else if (MatchNoCase("SimulatorSpecimen")) {
+        simParams = SimPlugGetParams();
+        if (itemEmpty[4])
+          AfxMessageBox("The SimulatorSpecimen property needs at least 4 values: hole "
+            "diameter, hole spacing, counts per second, and carbon transmission",
+            MB_EXCLAME);
+        else {
+          simParams->holeDiameter = itemFlt[1];
+          simParams->holeSpacing = itemFlt[2];
+          simParams->countsPerSec = itemFlt[3];
+          simParams->carbonTransmission = itemFlt[4];
+          if (!itemEmpty[5])
+            simParams->driftRate = itemFlt[5];
+          if (!itemEmpty[6])
+            simParams->driftDecay = itemFlt[6];
+        }
+      }
       else if (MatchNoCase("DebugOutput"))
         mWinApp->SetDebugOutput(strItems[1]);
+      else if (MatchNoCase("DebugOutputFile")) {
+        StripItems(strLine, 2, message);
+        mWinApp->SetDebugOutputFile(itemInt[1], message);
+      }
       else if (MatchNoCase("ActiveCameraList")) {
         index = 0;
         while (!strItems[index + 1].IsEmpty() && index < MAX_CAMERAS) {
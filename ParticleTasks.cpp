@@ -69,6 +69,7 @@ CParticleTasks::CParticleTasks(void)
   mMSRunningMacro = false;
   mMSMacroToRun = 0;
   mMSDropPlusFromName = true;
+  mMSPipelineParTS = true;
   mMSStartedCtfplotter = false;
   mZBGIterationNum = -1;
   mZBGMaxIterations = 5;
@@ -541,6 +542,8 @@ int CParticleTasks::StartMultiShot(int numPeripheral, int doCenter, float spokeR
   mMSLastHoleISX = mMSHoleISX[mMSNumHoles - 1];
   mMSLastHoleISY = mMSHoleISY[mMSNumHoles - 1];
   mMSLastFailed = true;
+  mMSStartTime = GetTickCount();
+  mMSNumShotsDone = 0;
 
   ind = StartOneShotOfMulti();
   if (ind)
@@ -572,7 +575,9 @@ int CParticleTasks::StartMultiShot(MultiShotParams *msParams, CameraParameters *
  */
 void CParticleTasks::MultiShotNextTask(int param)
 {
-  int nextShot, nextHole, err, storeNum;
+  int nextShot, nextHole, err, storeNum, procHole;
+  bool deferProc = false;
+  double elapsed;
   KImageStore *storeMRC;
   CString errStr;
   if (mMSCurIndex < -1) {
@@ -584,6 +589,7 @@ void CParticleTasks::MultiShotNextTask(int param)
   // Save Record
   mMSRunningMacro = false;
   mRecConSet->alignFrames = mSavedAlignFlag;
+  mMSNumShotsDone++;
   if (mMSSaveRecord && mMSImageReturned) {
     if (mMSsaveToMontage) {
       err = mWinApp->mMontageController->SavePiece();
@@ -602,7 +608,14 @@ void CParticleTasks::MultiShotNextTask(int param)
       StopMultiShot();
       return;
     }
-    if (mMSForParallelTS && ProcessParallelTSImage(errStr)) {
+
+    // Processing of a parallel TS image after the first position does not affect the
+    // next shot, whose image shift has already been queued, so in pipelined mode it is
+    // done after that shot is started
+    procHole = mMSHoleIndex;
+    deferProc = mMSForParallelTS && mMSPipelineParTS && mActPostExposure &&
+      mMSHoleIndex > 0 && !mMSDoStartMacro && GetNextShotAndHole(nextShot, nextHole);
+    if (mMSForParallelTS && !deferProc && ProcessParallelTSImage(mMSHoleIndex, errStr)) {
       StopMultiShot();
       SEMMessageBox("Error processing multishot image for parallel TS:\n" + errStr);
       return;
@@ -620,6 +633,10 @@ void CParticleTasks::MultiShotNextTask(int param)
     mMSHoleIndex = nextHole;
   } else {
     mMSLastFailed = false;
+    elapsed = SEMTickInterval(mMSStartTime) / 1000.;
+    if (elapsed > 0.)
+      SEMTrace('I', "Multishot did %d shots in %.1f sec, %.0f shots/hour",
+        mMSNumShotsDone, elapsed, 3600. * mMSNumShotsDone / elapsed);
     StopMultiShot();
     return;
   }
@@ -633,6 +650,19 @@ void CParticleTasks::MultiShotNextTask(int param)
       SetUpMultiShotShift(nextShot, nextHole, true);
   }
   StartOneShotOfMulti();
+
+  // Now process the previous image while this shot is being acquired; the camera does
+  // not put the new image in buffers until this returns.  If the shot failed to start,
+  // multishot has already been stopped and cleaned up, so just report the skip
+  if (deferProc) {
+    if (mMSCurIndex < -1) {
+      PrintfToLog("Multishot stopped before the parallel TS image at position %d was "
+        "processed", procHole + 1);
+    } else if (ProcessParallelTSImage(procHole, errStr)) {
+      StopMultiShot();
+      SEMMessageBox("Error processing multishot image for parallel TS:\n" + errStr);
+    }
+  }
 }
 
 int CParticleTasks::MultiShotBusy(void)
@@ -893,9 +923,10 @@ int CParticleTasks::StoreNumForCurrentShot()
 }
 
 /*
- * Do alignment and compose new reference for one image for parallel TS
+ * Do alignment and compose new reference for one image for parallel TS, taken at the
+ * given position, which may be before the current one when the processing is deferred
  */
-int CParticleTasks::ProcessParallelTSImage(CString &errStr)
+int CParticleTasks::ProcessParallelTSImage(int holeIndex, CString &errStr)
 {
   double initISX, initISY, aliISX, aliISY, pctShift;
   double delBTX, delBTY, delAstigX, delAstigY;
@@ -908,11 +939,11 @@ int CParticleTasks::ProcessParallelTSImage(CString &errStr)
   EMimageBuffer *otherStack;
   ScaleMat c2s;
   CString str, str2;
-  ParTSTargetData &ptsd = mParTSTargetData->ElementAt(mMSHoleIndex);
+  ParTSTargetData &ptsd = mParTSTargetData->ElementAt(holeIndex);
   ParallelTSOptions *parOpts = mNavHelper->GetParTSOptions();
 
-  if (parOpts->CtfMeasureType == 1 && mMSStartedCtfplotter && mMSHoleIndex > 0) {
-    ParTSTargetData &ptsdLast = mParTSTargetData->ElementAt(mMSHoleIndex - 1);
+  if (parOpts->CtfMeasureType == 1 && mMSStartedCtfplotter && holeIndex > 0) {
+    ParTSTargetData &ptsdLast = mParTSTargetData->ElementAt(holeIndex - 1);
     err = mWinApp->mProcessImage->FinishCtfplotterRun(10000, errStr);
     mMSStartedCtfplotter = false;
     if (!err) {
@@ -923,21 +954,21 @@ int CParticleTasks::ProcessParallelTSImage(CString &errStr)
     }
     if (err) {
       ptsdLast.score = -1;
-      PrintfToLog("CTF fit failed at position %d: %s", mMSHoleIndex, (LPCTSTR)errStr);
+      PrintfToLog("CTF fit failed at position %d: %s", holeIndex, (LPCTSTR)errStr);
     }
-    OutputDebugPositionAndCTF(mMSHoleIndex - 1);
+    OutputDebugPositionAndCTF(holeIndex - 1);
   }
 
-  if (parOpts->CtfMeasureType > 0 && GetCtfOfParallelTSImage(
+  if (parOpts->CtfMeasureType > 0 && GetCtfOfParallelTSImage(holeIndex,
     ptsd.defocusByCTF, ptsd.astig, ptsd.score, ptsd.fitRes, errStr)) {
     ptsd.score = -1.;
-    PrintfToLog("CTF fit failed at position %d: %s", mMSHoleIndex + 1, (LPCTSTR)errStr);
+    PrintfToLog("CTF fit failed at position %d: %s", holeIndex + 1, (LPCTSTR)errStr);
   }
   if (mMSCurIndex < -1)
     return 1;
 
   mParTSRefImBufs = mTSController->GetParTSRefImBufs(direction);
-  if (!mMSHoleIndex) {
+  if (!holeIndex) {
 
     // First position: align to the regular autoalign reference buffer
     mParTSFirstImageInBuf = 0;
@@ -983,13 +1014,13 @@ int CParticleTasks::ProcessParallelTSImage(CString &errStr)
     mParTSFirstImageInBuf = 1;
   } else {
 
-    hasRef = mParTSRefImBufs[mMSHoleIndex - 1].mImage != NULL;
-    extractedRef = mParTSRefImBufs[mMSHoleIndex - 1].mCaptured == BUFFER_PROC_OK_FOR_MAP;
+    hasRef = mParTSRefImBufs[holeIndex - 1].mImage != NULL;
+    extractedRef = mParTSRefImBufs[holeIndex - 1].mCaptured == BUFFER_PROC_OK_FOR_MAP;
     if (!firstTilt || hasRef) {
 
       // Other positions - copy reference to B and align
       mParTSFirstImageInBuf = 2;
-      mWinApp->mBufferManager->CopyImBuf(&mParTSRefImBufs[mMSHoleIndex - 1], &mImBufs[1],
+      mWinApp->mBufferManager->CopyImBuf(&mParTSRefImBufs[holeIndex - 1], &mImBufs[1],
         false);
 
       if (parOpts->alignLimitFrac > 0.)
@@ -1006,14 +1037,14 @@ int CParticleTasks::ProcessParallelTSImage(CString &errStr)
         err = mShiftManager->AutoAlign(1, 1, false);
         //mScope->GetImageShift(aliISX, aliISY);
         //mScope->SetImageShift(initISX, initISY);
-        //SEMTrace('1', "pos %d delIS %.3f %.3f -> %.3f %.3f", mMSHoleIndex + 1, 
+        //SEMTrace('1', "pos %d delIS %.3f %.3f -> %.3f %.3f", holeIndex + 1, 
         // initISX - mBaseISX, initISY- mBaseISY, aliISX - mBaseISX, aliISY - mBaseISY);
       }
       if (err) {
-        PrintfToLog("Autoalign failed at position %d", mMSHoleIndex + 1);
+        PrintfToLog("Autoalign failed at position %d", holeIndex + 1);
         ptsd.shiftX = EXTRA_NO_VALUE;
         /* Do not recall why this was there when shift limit disabled
-        if (mMSHoleIndex > 1) {
+        if (holeIndex > 1) {
           StopMultiShot();
           return 1;
         } */
@@ -1039,14 +1070,14 @@ int CParticleTasks::ProcessParallelTSImage(CString &errStr)
       if (mWinApp->mProcessImage->ReduceImage(mImBufs, reduction, &errStr, 1, false))
         return 1;
       mImBufs[1].mImage->setShifts(shiftX / reduction, shiftY / reduction);
-      mWinApp->mBufferManager->CopyImBuf(&mImBufs[1], &mParTSRefImBufs[mMSHoleIndex - 1],
+      mWinApp->mBufferManager->CopyImBuf(&mImBufs[1], &mParTSRefImBufs[holeIndex - 1],
         false);
 
       // Place image in other stack too on first tilt if no image or if it was a virtual
       // reference from area map
       if (firstTilt && (!hasRef || extractedRef)) {
         otherStack = mTSController->GetParTSRefImBufs(direction > 0 ? 0 : 1);
-        mWinApp->mBufferManager->CopyImBuf(&mImBufs[1], &otherStack[mMSHoleIndex - 1],
+        mWinApp->mBufferManager->CopyImBuf(&mImBufs[1], &otherStack[holeIndex - 1],
           false);
       }
     }
@@ -1056,7 +1087,7 @@ int CParticleTasks::ProcessParallelTSImage(CString &errStr)
     mParTSFirstImageInBuf = 1;
   }
   if (!mMSStartedCtfplotter)
-    OutputDebugPositionAndCTF(mMSHoleIndex);
+    OutputDebugPositionAndCTF(holeIndex);
   return 0;
 }
 
@@ -1090,11 +1121,11 @@ void CParticleTasks::OutputDebugPositionAndCTF(int holeIndex)
 }
 
 /*
- * Run Ctfplotter or ctffind routine on current shot to determine defocus and other 
- * values from which quality can be determined
+ * Run Ctfplotter or ctffind routine on the shot at the given position to determine
+ * defocus and other values from which quality can be determined
  */
-int CParticleTasks::GetCtfOfParallelTSImage(float &defocus, float &astig, float &score, 
-  float &fitRes, CString &errStr)
+int CParticleTasks::GetCtfOfParallelTSImage(int holeIndex, float &defocus, float &astig,
+  float &score, float &fitRes, CString &errStr)
 {
   float expectDef = mTSController->GetParTSExpectedDefocus();
   int direction = mTSController->GetDirection();
@@ -1154,11 +1185,11 @@ int CParticleTasks::GetCtfOfParallelTSImage(float &defocus, float &astig, float
       return 1;
     }
     if (processImg->RunCtfplotterOnBuffer(filename, command, 
-      (mMSHoleIndex < mMSNumHoles - 1) ? - 1 : 10000)) {
+      (holeIndex < mMSNumHoles - 1) ? - 1 : 10000)) {
       errStr = command;
       return 1;
     }
-    mMSStartedCtfplotter = mMSHoleIndex < mMSNumHoles - 1;
+    mMSStartedCtfplotter = holeIndex < mMSNumHoles - 1;
     if (mMSStartedCtfplotter)
       return 0;
     if (mWinApp->mExternalTools->ReadCtfplotterResults(defocus, astig,
@@ -1762,6 +1793,9 @@ int CParticleTasks::WaitForDrift(DriftWaitParams &param, bool useImageInA,
   // Take image or autofocus
   if (param.measureType == WFD_USE_TRIAL || param.measureType == WFD_USE_FOCUS) {
     mCamera->SetRequiredRoll(1);
+
+    // Each image becomes the reference for the next, so keep its filtered spectrum
+    mShiftManager->SetKeepRefSpectrum(true, true);
     if (!useImageInA)
       mCamera->InitiateCapture(shotType);
   } else {
@@ -1920,6 +1954,7 @@ void CParticleTasks::StopWaitForDrift(void)
   mWinApp->UpdateBufferWindows();
   mWinApp->SetStatusText(MEDIUM_PANE, "");
   mCamera->SetRequiredRoll(0);
+  mShiftManager->SetKeepRefSpectrum(false);
   mFocusManager->SetTripleMode(mWDSavedTripleMode);
   mFocusManager->SetRefocusThreshold(mWDRefocusThreshold);
 }
@@ -2809,10 +2844,18 @@ void CParticleTasks::AlignOrCenterHoleResetIS()
 int CParticleTasks::DoCenteringAutoAlign(bool cropping)
 {
   int alignErr;
+
+  // When aligning to the template, keep its filtered spectrum after the alignment so
+  // that it is reused for following items as long as the template buffer is unchanged
+  bool keepTemplate = !mATIterationNum && !mATHoleCenteringMode;
   mWinApp->mShiftManager->SetNextAutoalignLimit(mATParams.maxAlignShift);
+  if (keepTemplate)
+    mWinApp->mShiftManager->SetKeepRefSpectrum(true, false, true);
   alignErr = mWinApp->mShiftManager->AutoAlign(B3DCHOICE(mATIterationNum,
     cropping ? 2 : 1, mATParams.loadAndKeepBuf), 1, true, AUTOALIGN_KEEP_SPOTS, NULL,
     0., 0., 0., 0., 0., NULL, NULL, GetDebugOutput('1'));
+  if (keepTemplate)
+    mWinApp->mShiftManager->SetKeepRefSpectrum(false, false, true);
   if (alignErr) {
     CString mess;
     mess.Format(alignErr < 0 ? "%s autoalignment failed to find a peak within"
@@ -2877,6 +2920,11 @@ void CParticleTasks::StopTemplateAlign()
     mWinApp->mLowDoseDlg.SetLowDoseMode(true);
   mATDidSaveState = false;
 
+  // Free a kept template spectrum unless Navigator acquire will align again; it is freed
+  // when the acquire stops
+  if (!mWinApp->mNavigator || !mWinApp->mNavigator->GetAcquiring())
+    mWinApp->mShiftManager->SetKeepRefSpectrum(false);
+
   mCamera->SetRequiredRoll(0);
   mWinApp->UpdateBufferWindows();
   mWinApp->SetStatusText(MEDIUM_PANE, "");
@@ -67,6 +67,7 @@ public:
   GetSetMember(int, MSMacroToRun);
   GetSetMember(BOOL, MSRunMacro);
   GetSetMember(BOOL, MSDropPlusFromName);
+  GetSetMember(BOOL, MSPipelineParTS);
   GetMember(BOOL, MSRunningMacro);
   FloatVec *GetZBGFocusScalings() { return &mZBGFocusScalings; };
   SetMember(MultiShotParams *, NextMSParams);
@@ -125,6 +126,9 @@ private:
   MultiShotParams *mNextMSParams;  // Temporary pointer to params to use for next run
   bool mMSsaveToMontage;           // Flag to save through montage savePiece
   BOOL mMSDropPlusFromName;        // Flag to drop + character from hole name if UTAPI
+  BOOL mMSPipelineParTS;          // Flag to process parallel TS image during next shot
+  double mMSStartTime;            // Time multishot started, for throughput
+  int mMSNumShotsDone;            // Number of shots completed
   int mMSTestRun;
   int mMagIndex;                   // Mag index for the run
   int mSavedAlignFlag;
@@ -258,9 +262,10 @@ public:
     double &delAstigX, double &delAstigY, BOOL queueIt, BOOL debug);
   int StartOneShotOfMulti(void);
   int StoreNumForCurrentShot();
-  int ProcessParallelTSImage(CString &errStr);
+  int ProcessParallelTSImage(int holeIndex, CString &errStr);
   void OutputDebugPositionAndCTF(int holeIndex);
-  int GetCtfOfParallelTSImage(float &defocus, float &astig, float &score, float &fitRes, CString &errStr);
+  int GetCtfOfParallelTSImage(int holeIndex, float &defocus, float &astig, float &score,
+    float &fitRes, CString &errStr);
   void MultiShotNextTask(int param);
   void StopMultiShot(void);
   void MultiShotCleanup(int error);
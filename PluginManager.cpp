@@ -7,6 +7,7 @@
 #include "TSController.h"
 #include "CameraController.h"
 #include "PiezoAndPPControl.h"
+#include "SimulatedPlugin.h"
 
 #if defined(_DEBUG) && defined(_CRTDBG_MAP_ALLOC)
 #define new DEBUG_NEW
@@ -456,12 +457,53 @@ int CPluginManager::LoadPlugins(void)
       mWinApp->AppendToLog(CString("An error occurred getting filenames in the ") +
       CString(dirLoop ? "Plugins" : "SerialEM executable") + "directory", action);
   }
+  AddSimulatedPlugins(action);
   if (twoScopes)
     mScopePlugIndex = -1;
 
   return (int)mPlugins.GetSize();
 }
 
+// Add the built-in simulated scope and/or camera as plugins without a library handle if
+// the property calls for them.  The scope is skipped if a real one was loaded
+void CPluginManager::AddSimulatedPlugins(int action)
+{
+  SimulatorParams *params = SimPlugGetParams();
+  PluginData *newPlug;
+  bool callsAdded = false;
+  if (params->enable & SIMPLUG_SCOPE) {
+    if (mScopePlugIndex >= 0) {
+      mWinApp->AppendToLog("A microscope plugin was loaded, so the simulated scope "
+        "will not be used", action);
+    } else {
+      newPlug = new PluginData;
+      newPlug->handle = NULL;
+      newPlug->shortName = "SimulatedScope";
+      newPlug->flags = PLUGFLAG_SCOPE;
+      newPlug->calls.SetSize(0, 4);
+      SimPlugFillScopeFuncs(&mScopeFuncs);
+      SimPlugAddScriptCalls(newPlug->calls);
+      callsAdded = true;
+      mScopePlugIndex = (int)mPlugins.GetSize();
+      mPlugins.Add(newPlug);
+      SEMTrace('1', "Added built-in simulated microscope plugin");
+    }
+  }
+  if (params->enable & SIMPLUG_CAMERA) {
+    newPlug = new PluginData;
+    newPlug->handle = NULL;
+    newPlug->shortName = "SimulatedCamera";
+    newPlug->flags = PLUGFLAG_CAMERA;
+    newPlug->calls.SetSize(0, 4);
+    newPlug->camFuncs = new CamPluginFuncs;
+    SimPlugFillCameraFuncs(newPlug->camFuncs);
+    if (!callsAdded)
+      SimPlugAddScriptCalls(newPlug->calls);
+    mPlugins.Add(newPlug);
+    SEMTrace('1', "Added built-in simulated camera plugin");
+  }
+}
+
 CString CPluginManager::GetScopePluginName()
 {
   PluginData *plugin;
@@ -485,7 +527,8 @@ void CPluginManager::ReleasePlugins(void)
       plugin->piezoFuncs->Uninitialize();
     if (plugin->flags & PLUGFLAG_SCRIPT_LANG && plugin->scriptLangFuncs->Uninitialize)
       plugin->scriptLangFuncs->Uninitialize();
-    AfxFreeLibrary(plugin->handle);
+    if (plugin->handle)
+      AfxFreeLibrary(plugin->handle);
     delete plugin;
   }
   delete mDEcamFuncs;
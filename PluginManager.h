@@ -274,6 +274,7 @@ private:
   CString mExePath;
 public:
   int LoadPlugins(void);
+  void AddSimulatedPlugins(int action);
   double ExecuteCommand(CString strLine, int *itemInt, double *itemDbl, BOOL *itemEmpty,
     CString &report, double &outD1, double &outD2, double &outD3, int &numOut, 
     CString &retString, int &err, CString *strItems = NULL);
@@ -71,6 +71,7 @@ CProcessImage::CProcessImage()
   mShortCatalaseNM = 6.85f;
   mLongCatalaseNM = 8.75f;
   mGridMeshSize = 0;
+  mPixelSubPatches = 0;
   mPixelTimeStamp = 0;
   mPlatePhase = 0.;
   mNumFFTZeros = 5;
@@ -102,6 +103,7 @@ CProcessImage::CProcessImage()
   mTuneUseCtfplotter = false;
   mRunningCtfplotter = 0;
   mMinCtfplotterPixel = 0.115f;  // Nanometers
+  mCtfpFileMsec = 0.;
   mShrMemIIFile = NULL;
   ctffindSetPrintFunc(ctffindPrintFunc);
   ctffindSetSliceWriteFunc(ctffindDumpFunc);
@@ -2793,16 +2795,41 @@ double CProcessImage::WholeImageMean(EMimageBuffer *imBuf)
   return retval;
 }
 
+#define MAX_PATCH_THREADS 8
+
+// Macro for PatchPercentileStats: add the values of one patch of integer data to the
+// histogram, keeping track of the range of bins that were used
+#define PATCH_HISTOGRAM(tnam, data, typ, offset) \
+  case tnam:  \
+    for (jy = iy; jy < iy + patchSize; jy++) {  \
+      data = (typ *)imData + (size_t)jy * nxDim + ix;  \
+      for (jx = 0; jx < patchSize; jx++) {  \
+        bin = data[jx] + offset;  \
+        hist[bin]++;  \
+        ACCUM_MIN(minBin, bin);  \
+        ACCUM_MAX(maxBin, bin);  \
+      }  \
+    }  \
+    break;
+
 // Compute percentile statistics from image patches
 int CProcessImage::PatchPercentileStats(EMimageBuffer *imBuf, float lowPct, float highPct,
   float midCrit, float rangeCrit, int patchSize, float &lowMean, float &highMean,
   float &midAbove, float &rangeAbove, CString &errStr)
 {
   float lowSum = 0., highSum = 0., lowVal, highVal, totPatch;
-  int numXpatch, numYpatch, delXpatch, delYpatch, ix, iy, xpat, ypat, xStart, yStart;
-  int pixSize, chan;
-  float *patch;
-  int type, nx, ny, numMid = 0, numRange = 0, numPix;
+  int numXpatch, numYpatch, delXpatch, delYpatch, ix, iy, xStart, yStart;
+  int pixSize, chan, numPatch, pat, thread, numThreads, jx, jy, bin, minBin, maxBin;
+  int lowRank, highRank, cumul, histSize = 0, offset = 0;
+  size_t patchArrSize = 0;
+  float *patches = NULL, *patch;
+  int *hists = NULL, *hist;
+  unsigned char *bdata;
+  short int *sdata;
+  unsigned short int *usdata;
+  void *imData;
+  FloatVec lowVals, highVals;
+  int type, nx, ny, nxDim, numMid = 0, numRange = 0, numPix;
   KImage *image;
   if (!imBuf || !imBuf->mImage) {
     errStr = "Image buffer or image is NULL";
@@ -2816,48 +2843,110 @@ int CProcessImage::PatchPercentileStats(EMimageBuffer *imBuf, float lowPct, floa
   }
   dataSizeForMode(type, &pixSize, &chan);
   image->getSize(nx, ny);
+  nxDim = image->getRowBytes() / pixSize;
   numXpatch = (nx + patchSize - 1) / patchSize;
   numYpatch = (ny + patchSize - 1) / patchSize;
+  if (numXpatch < 2 || numYpatch < 2) {
+    errStr = "The image must be bigger than the patch in each dimension";
+    return 4;
+  }
   delXpatch = (nx - patchSize) / (numXpatch - 1);
   delYpatch = (ny - patchSize) / (numYpatch - 1);
   xStart = (nx - (patchSize + (numXpatch - 1) * delXpatch)) / 2;
   yStart = (ny - (patchSize + (numYpatch - 1) * delYpatch)) / 2;
   numPix = patchSize * patchSize;
-  if (numXpatch < 2 || numYpatch < 2) {
-    errStr = "The image must be bigger than the patch in each dimension";
-    return 4;
+  numPatch = numXpatch * numYpatch;
+  lowRank = B3DNINT(lowPct * numPix / 100.);
+  highRank = B3DNINT(highPct * numPix / 100.);
+  B3DCLAMP(lowRank, 1, numPix);
+  B3DCLAMP(highRank, 1, numPix);
+
+  // Integer data are histogrammed in place, float data need to be copied for selection
+  if (type == MRC_MODE_BYTE)
+    histSize = 256;
+  else if (type == MRC_MODE_SHORT || type == MRC_MODE_USHORT)
+    histSize = 65536;
+  if (type == MRC_MODE_SHORT)
+    offset = 32768;
+  numThreads = numOMPthreads(B3DMIN(MAX_PATCH_THREADS, numPatch));
+  if (histSize) {
+    hists = B3DMALLOC(int, histSize * numThreads);
+    if (hists)
+      memset(hists, 0, histSize * numThreads * sizeof(int));
+  } else {
+    patchArrSize = (size_t)numPix;
+    patches = B3DMALLOC(float, patchArrSize * numThreads);
   }
-  NewArray(patch, float, patchSize * patchSize);
-  if (!patch) {
-    errStr = "Error allocating array for patches";
+  if (!hists && !patches) {
+    errStr = "Error allocating arrays for patches";
     return 1;
   }
+  lowVals.resize(numPatch);
+  highVals.resize(numPatch);
 
   image->Lock();
-  for (ypat = 0; ypat < numYpatch; ypat++) {
-    iy = yStart + ypat * delYpatch;
-    for (xpat = 0; xpat < numXpatch; xpat++) {
-      ix = xStart + xpat * delXpatch;
-      sliceTaperInPad(image->getData(), type, image->getRowBytes() / pixSize, ix,
-        ix + patchSize - 1, iy, iy + patchSize - 1, patch, patchSize, patchSize,
-        patchSize, 0, 0);
-      lowVal = percentileFloat(B3DNINT(lowPct * numPix / 100.), patch, numPix);
-      highVal = percentileFloat(B3DNINT(highPct * numPix / 100.), patch, numPix);
-      lowSum += lowVal;
-      highSum += highVal;
-      if ((lowVal + highVal) / 2 > midCrit)
-        numMid++;
-      if (highVal - lowVal > rangeCrit)
-        numRange++;
+  imData = image->getData();
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numPatch, numXpatch, xStart, yStart, delXpatch, delYpatch, histSize, hists, \
+  patches, patchArrSize, imData, type, nxDim, patchSize, offset, numPix, lowRank, \
+  highRank, lowVals, highVals) \
+  private(pat, thread, ix, iy, hist, patch, jx, jy, bin, minBin, maxBin, cumul, \
+  lowVal, highVal, bdata, sdata, usdata)
+  for (pat = 0; pat < numPatch; pat++) {
+    thread = b3dOMPthreadNum();
+    iy = yStart + (pat / numXpatch) * delYpatch;
+    ix = xStart + (pat % numXpatch) * delXpatch;
+    if (histSize) {
+
+      // Get both percentiles from one pass through the histogram, then clear the part
+      // that was used
+      hist = hists + thread * histSize;
+      minBin = histSize;
+      maxBin = -1;
+      switch (type) {
+        PATCH_HISTOGRAM(MRC_MODE_BYTE, bdata, unsigned char, 0);
+        PATCH_HISTOGRAM(MRC_MODE_SHORT, sdata, short int, offset);
+        PATCH_HISTOGRAM(MRC_MODE_USHORT, usdata, unsigned short int, 0);
+      }
+      cumul = 0;
+      lowVal = highVal = (float)(maxBin - offset);
+      for (bin = minBin; bin <= maxBin; bin++) {
+        if (cumul < lowRank && cumul + hist[bin] >= lowRank)
+          lowVal = (float)(bin - offset);
+        if (cumul < highRank && cumul + hist[bin] >= highRank)
+          highVal = (float)(bin - offset);
+        cumul += hist[bin];
+        if (cumul >= lowRank && cumul >= highRank)
+          break;
+      }
+      memset(hist + minBin, 0, (maxBin + 1 - minBin) * sizeof(int));
+    } else {
+      patch = patches + thread * patchArrSize;
+      sliceTaperInPad(imData, type, nxDim, ix, ix + patchSize - 1, iy,
+        iy + patchSize - 1, patch, patchSize, patchSize, patchSize, 0, 0);
+      lowVal = percentileFloat(lowRank, patch, numPix);
+      highVal = percentileFloat(highRank, patch, numPix);
     }
+    lowVals[pat] = lowVal;
+    highVals[pat] = highVal;
   }
   image->UnLock();
-  totPatch = (float)(numXpatch * numYpatch);
+
+  for (pat = 0; pat < numPatch; pat++) {
+    lowSum += lowVals[pat];
+    highSum += highVals[pat];
+    if ((lowVals[pat] + highVals[pat]) / 2 > midCrit)
+      numMid++;
+    if (highVals[pat] - lowVals[pat] > rangeCrit)
+      numRange++;
+  }
+  totPatch = (float)numPatch;
   lowMean = lowSum / totPatch;
   highMean = highSum / totPatch;
   midAbove = (float)numMid / totPatch;
   rangeAbove = (float)numRange / totPatch;
-  delete[] patch;
+  B3DFREE(hists);
+  B3DFREE(patches);
   return 0;
 }
 
@@ -2978,6 +3067,8 @@ void CProcessImage::OnMeshForGridBars()
 #define MAX_SCAN 64
 #define MAX_AUTO_TARGET 7
 #define MAX_MESS_BUF 200
+#define MAX_PIX_THREADS 8
+#define MIN_SUB_PATCH 128
 
 // Find a pixel size either de novo or from point marked in autocorrelation
 // Pass in spacing non-zero to override catalase, grid mesh, and grid lines/mm
@@ -3000,6 +3091,10 @@ int CProcessImage::FindPixelSize(float markedX, float markedY, float minScale,
   double gridNM = B3DCHOICE(spacing != 0, 1000. / spacing, 1000000. / mGridLinesPerMM);
   float delta, corMin, corMax, tryX;
   int trimX, trimY, nxPad, nyPad, ix1, iy1, nxTaper, nyTaper, ind1, ind2, numDiv;
+  int nxBin, nyBin, xStart, yStart, linesPerStrip, elSize, numThreads, ix, iy;
+  int numPatchFound = 0;
+  FloatVec spacings1, spacings2;
+  float patchMean, patchSD, patchSEM, patchMin, patchMax;
   double dist, pixel;
   float angle, dist1, dist2;
   double pixel1, pixel2;
@@ -3076,9 +3171,31 @@ int CProcessImage::FindPixelSize(float markedX, float markedY, float minScale,
       SEMMessageBox("Failed to get memory for binned image", MB_EXCLAME);
       return 1;
     }
-    XCorrBinByN(data, imType, nx, ny, needBin, temp);
-    nx /= needBin;
-    ny /= needBin;
+
+    // Bin in strips of lines in parallel, centered the same way as in XCorrBinByN
+    nxBin = nx / needBin;
+    nyBin = ny / needBin;
+    xStart = (nx % needBin) / 2;
+    yStart = (ny % needBin) / 2;
+    elSize = imType == kFLOAT ? 4 : 2;
+    numThreads = B3DNINT(sqrt((double)nx * ny) / 1024.);
+    B3DCLAMP(numThreads, 1, MAX_PIX_THREADS);
+    numThreads = numOMPthreads(numThreads);
+    linesPerStrip = (nyBin + numThreads - 1) / numThreads;
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numThreads, linesPerStrip, nxBin, nyBin, xStart, yStart, needBin, elSize, \
+  data, imType, nx, temp) \
+  private(ind1, ind2, ix, iy)
+    for (ind1 = 0; ind1 < numThreads; ind1++) {
+      ind2 = B3DMIN(nyBin, (ind1 + 1) * linesPerStrip) - ind1 * linesPerStrip;
+      if (ind2 > 0)
+        extractWithBinning(data, imType, nx, xStart, xStart + nxBin * needBin - 1,
+          yStart + ind1 * linesPerStrip * needBin,
+          yStart + (ind1 * linesPerStrip + ind2) * needBin - 1, needBin,
+          (char *)temp + (size_t)ind1 * linesPerStrip * nxBin * elSize, 0, &ix, &iy);
+    }
+    nx = nxBin;
+    ny = nyBin;
     if (imType == kUBYTE || imType == kRGB)
       imType = kSHORT;
     data = temp;
@@ -3110,6 +3227,19 @@ int CProcessImage::FindPixelSize(float markedX, float markedY, float minScale,
   nyTaper = (int)(taperFrac * (iy1 + 1 - trimY));
   XCorrTaperInPad(data, imType, nx, trimX, ix1, trimY, iy1, array,
         nxPad + 2, nxPad, nyPad, nxTaper, nyTaper);
+
+  // Analyze sub-patches if selected and they are big enough
+  if (mPixelSubPatches > 1 && !(findFlags & FIND_ACPK_NO_WAFFLE)) {
+    if ((ix1 + 1 - trimX) / mPixelSubPatches < MIN_SUB_PATCH ||
+      (iy1 + 1 - trimY) / mPixelSubPatches < MIN_SUB_PATCH)
+      PrintfToLog("Binned image is too small to analyze %d x %d sub-patches",
+        mPixelSubPatches, mPixelSubPatches);
+    else
+      numPatchFound = SubPatchPixelSpacings(data, imType, nx, trimX, ix1, trimY, iy1,
+        sigma1, taperFrac, doCatalase ? 16 : 64, catalFac,
+        findFlags & (FIND_ACPK_BOTH_GEOMS | FIND_ACPK_HEX_GRID), markedX, markedY,
+        spacings1, spacings2);
+  }
   image->UnLock();
   if (needBin > 1)
     delete [] temp;
@@ -3184,6 +3314,33 @@ int CProcessImage::FindPixelSize(float markedX, float markedY, float minScale,
       " %.4g nm, grid angle = %.2f deg", num[0], dist1, num[1], dist2, pixel, angle);
   }
   mWinApp->AppendToLog(report, LOG_OPEN_IF_CLOSED);
+
+  // Report the consistency of the pixel size from sub-patches
+  if (numPatchFound > 0) {
+    ind2 = 0;
+    patchMin = 1.e30f;
+    patchMax = 0.;
+    for (ind1 = 0; ind1 < (int)spacings1.size(); ind1++) {
+      if (!spacings1[ind1])
+        continue;
+      if (doCatalase)
+        spacings1[ind2] = (float)((mShortCatalaseNM / spacings1[ind1] +
+          2. * mLongCatalaseNM / spacings2[ind1]) / (2. * needBin));
+      else
+        spacings1[ind2] = (float)(2. * gridNM / 
+          ((spacings1[ind1] + spacings2[ind1]) * needBin));
+      ACCUM_MIN(patchMin, spacings1[ind2]);
+      ACCUM_MAX(patchMax, spacings1[ind2]);
+      ind2++;
+    }
+    avgSD(&spacings1[0], numPatchFound, &patchMean, &patchSD, &patchSEM);
+    PrintfToLog("From %d of %d sub-patches, (binned) pixel = %.4g +/- %.3g nm (%.2f%%), "
+      "range %.4g to %.4g", numPatchFound, (int)spacings1.size(), patchMean, patchSD,
+      100. * patchSD / patchMean, patchMin, patchMax);
+  } else if (spacings1.size()) {
+    PrintfToLog("Lattice peaks could not be found in any of the %d sub-patches",
+      (int)spacings1.size());
+  }
   if (magInd && camera >= 0 && binningShown &&
     magTab[magInd].pixelSize[camera]) {
       dist = 0.001 * pixel /
@@ -3261,6 +3418,78 @@ int CProcessImage::FindPixelSize(float markedX, float markedY, float minScale,
   return 0;
 }
 
+// Find the lattice spacings in each of an array of sub-patches of the binned image within
+// the given limits, doing the patches in parallel.  The two spacings for each patch are
+// returned in the vectors, with zeros for patches that failed; returns the number found
+int CProcessImage::SubPatchPixelSpacings(void *data, int imType, int nx, int ix0, 
+  int ix1, int iy0, int iy1, float sigma1, float taperFrac, int maxScan, float catalFac,
+  int findFlags, float markedX, float markedY, FloatVec &spacings1, FloatVec &spacings2)
+{
+  int numSide = mPixelSubPatches;
+  int numPatches = numSide * numSide;
+  int patchX = (ix1 + 1 - ix0) / numSide;
+  int patchY = (iy1 + 1 - iy0) / numSide;
+  int nxPad = XCorrNiceFrame(2 * patchX, 2, niceFFTlimit());
+  int nyPad = XCorrNiceFrame(2 * patchY, 2, niceFFTlimit());
+  int nxTaper = (int)(taperFrac * patchX);
+  int nyTaper = (int)(taperFrac * patchY);
+  size_t arrSize = (size_t)(nxPad + 2) * nyPad;
+  int patch, xStart, yStart, numThreads, nearInd, num[3], failed, numFound = 0;
+  int pass, startPatch, endPatch, passThreads;
+  float CTF[8193], delta, dist1, dist2, angle, vectors[4];
+  float *array, *peaks, *space1, *space2;
+  char messBuf[MAX_MESS_BUF];
+  double wallStart = wallTime();
+
+  spacings1.resize(numPatches);
+  spacings2.resize(numPatches);
+  space1 = &spacings1[0];
+  space2 = &spacings2[0];
+  XCorrSetCTF(sigma1, 0.f, 0.f, 0.f, CTF, nxPad, nyPad, &delta);
+  numThreads = numOMPthreads(B3DMIN(numPatches, MAX_PIX_THREADS));
+
+  // The FFT routine creates its plans on the first forward and inverse transforms of a
+  // given size, which is not thread-safe, so the first patch is done alone to make the
+  // plans, then the rest are done in parallel using them
+  for (pass = 0; pass < 2; pass++) {
+    startPatch = pass ? 1 : 0;
+    endPatch = pass ? numPatches : 1;
+    passThreads = pass ? numThreads : 1;
+#pragma omp parallel for num_threads(passThreads) schedule(dynamic) \
+  shared(startPatch, endPatch, numSide, ix0, iy0, patchX, patchY, nxPad, nyPad, nxTaper, \
+  nyTaper, arrSize, data, imType, nx, delta, CTF, maxScan, catalFac, findFlags, \
+  markedX, markedY, space1, space2) \
+  private(patch, xStart, yStart, array, peaks, dist1, dist2, angle, vectors, num, \
+  nearInd, messBuf, failed) \
+  reduction(+:numFound)
+    for (patch = startPatch; patch < endPatch; patch++) {
+      space1[patch] = space2[patch] = 0.;
+      array = B3DMALLOC(float, arrSize + 3 * MAX_GRID_PEAKS);
+      if (!array)
+        continue;
+      peaks = array + arrSize;
+      xStart = ix0 + (patch % numSide) * patchX;
+      yStart = iy0 + (patch / numSide) * patchY;
+      XCorrTaperInPad(data, imType, nx, xStart, xStart + patchX - 1, yStart,
+        yStart + patchY - 1, array, nxPad + 2, nxPad, nyPad, nxTaper, nyTaper);
+      XCorrCrossCorr(array, array, nxPad, nyPad, delta, CTF);
+      failed = findAutoCorrPeaks(array, nxPad, nyPad, peaks, peaks + MAX_GRID_PEAKS,
+        peaks + 2 * MAX_GRID_PEAKS, MAX_GRID_PEAKS, maxScan, catalFac, findFlags,
+        markedX, markedY, &dist1, &dist2, &angle, vectors, num, &nearInd, &messBuf[0],
+        MAX_MESS_BUF);
+      if (!failed) {
+        space1[patch] = dist1;
+        space2[patch] = dist2;
+        numFound++;
+      }
+      free(array);
+    }
+  }
+  SEMTrace('1', "Analyzed %d sub-patches %d x %d with %d threads in %.0f msec",
+    numPatches, patchX, patchY, numThreads, 1000. * (wallTime() - wallStart));
+  return numFound;
+}
+
 // Output the relative rotations between mags with pixel size measurements
 void CProcessImage::OnListRelativeRotations()
 {
@@ -4183,7 +4412,7 @@ int CProcessImage::RunCtffind(EMimageBuffer *imBuf, CtffindParams &params,
   float pixelSave = params.pixel_size_of_input_image;
   float minFracOfNyquistForMaxRes = 0.6f;
   CString mess, str;
-  double wallStart = wallTime();
+  double wallStart = wallTime(), specTime;
   int numPoints, padSize, err, useBox, start, end, val;
   KImage *image = imBuf->mImage;
   if (!image)
@@ -4221,6 +4450,7 @@ int CProcessImage::RunCtffind(EMimageBuffer *imBuf, CtffindParams &params,
       PrintfToLog("Error %d extracting reduced spectrum from larger box to smaller", err);
     params.pixel_size_of_input_image *= (float)useBox / (float)params.box_size;
   }
+  specTime = wallTime();
 
   // Save parameters in case of crash
   mBufIndForCtffind = (int)(imBuf - mImBufs);
@@ -4251,7 +4481,9 @@ int CProcessImage::RunCtffind(EMimageBuffer *imBuf, CtffindParams &params,
     }
     if (!skipOutput)
       mWinApp->AppendToLog(mess);
-    //PrintfToLog("Elapsed time %.3f sec", wallTime() - wallStart);
+    SEMTrace('p', "Ctffind took %.0f msec: %.0f to get spectrum, %.0f to fit",
+      1000. * (wallTime() - wallStart), 1000. * (specTime - wallStart),
+      1000. * (wallTime() - specTime));
   } else {
     err = 1;
   }
@@ -4327,6 +4559,7 @@ int CProcessImage::MakeCtfplotterShrMemFile(int bufInd, CString &filename,
   float &reduction)
 {
   float imPixel = 1000.f * mWinApp->mShiftManager->GetPixelSize(&mImBufs[bufInd]);
+  double wallStart = wallTime();
   if (!imPixel) {
     filename = "No pixel size is available for running Ctfplotter on this image";
     return 1;
@@ -4336,6 +4569,7 @@ int CProcessImage::MakeCtfplotterShrMemFile(int bufInd, CString &filename,
     "ctftmp.mrc", filename, reduction);
   if (!mShrMemIIFile)
     return 1;
+  mCtfpFileMsec = (float)(1000. * (wallTime() - wallStart));
   return 0;
 }
 
@@ -4368,6 +4602,8 @@ int CProcessImage::FinishCtfplotterRun(int timeOut, CString &errStr)
 {
   int retVal = 0;
   DWORD waitResult, exitStatus;
+  FILETIME createTime, exitTime, kernelTime, userTime;
+  double runMsec;
   do {
     waitResult = WaitForSingleObject(mWinApp->mExternalTools->mExtProcInfo.hProcess, 20);
     if (waitResult == WAIT_OBJECT_0) {
@@ -4380,6 +4616,18 @@ int CProcessImage::FinishCtfplotterRun(int timeOut, CString &errStr)
     //SleepMsg(2);
 
   if (!mRunningCtfplotter) {
+
+    // Get the run time from process creation to exit, since the wait may have started
+    // long after the process ended when it was run asynchronously
+    if (GetProcessTimes(mWinApp->mExternalTools->mExtProcInfo.hProcess, &createTime,
+      &exitTime, &kernelTime, &userTime))
+      runMsec = 1.e-4 * (double)(((__int64)exitTime.dwHighDateTime << 32) +
+        exitTime.dwLowDateTime - ((__int64)createTime.dwHighDateTime << 32) -
+        createTime.dwLowDateTime);
+    else
+      runMsec = SEMTickInterval(mCtfpStartTime);
+    SEMTrace('p', "Ctfplotter took %.0f msec: %.0f to make shared memory file, %.0f to "
+      "run", mCtfpFileMsec + runMsec, mCtfpFileMsec, runMsec);
     GetExitCodeProcess(mWinApp->mExternalTools->mExtProcInfo.hProcess, &exitStatus);
     if (exitStatus) {
       errStr.Format("ctfplotter exited with status %d", exitStatus);
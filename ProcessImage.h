@@ -76,6 +76,7 @@ public:
   GetSetMember(int, NumCircles);
   GetSetMember(float, GridLinesPerMM);
   GetSetMember(int, GridMeshSize);
+  GetSetMember(int, PixelSubPatches);
   SetMember(float, ShortCatalaseNM);
   SetMember(float, LongCatalaseNM);
   GetSetMember(BOOL, CatalaseForPixel);
@@ -190,6 +191,7 @@ private:
   float mBeamShiftFromImage;  // Last value of micron shift centering from image
   int mFlucamRotationFlip;    // Rotation/flip to apply to beam shift in EFTEM on screen
   int mGridMeshSize;          // Mesh to calibrate from grid bar spacing
+  int mPixelSubPatches;       // Number of sub-patches on a side for consistency check
   int mPixelTimeStamp;        // Time stamp of LAST pixel size measurement
   int mNumFFTZeros;
   float mAmpRatio;
@@ -224,6 +226,7 @@ private:
   ImodImageFile *mShrMemIIFile; // File created with buffer in shared memory
   float mMinCtfplotterPixel;    // Minimum pixel size, reduce to this in shared mem file
   double mCtfpStartTime;        // Time process was started
+  float mCtfpFileMsec;          // Time taken to make the shared memory file
  
 public:
   afx_msg void OnProcessMinmaxmean();
@@ -251,6 +254,9 @@ public:
                                         float &corMin, float &corMax);
   int FindPixelSize(float markedX, float markedY, float minScale, float maxScale, int bufInd, 
     int findFlags, float &spacing, float vectors[4]);
+  int SubPatchPixelSpacings(void *data, int imType, int nx, int ix0, int ix1, int iy0,
+    int iy1, float sigma1, float taperFrac, int maxScan, float catalFac, int findFlags,
+    float markedX, float markedY, FloatVec &spacings1, FloatVec &spacings2);
   afx_msg void OnProcessPixelsizefrommarker();
   afx_msg void OnUpdateProcessPixelsizefrommarker(CCmdUI *pCmdUI);
   bool OverlayImages(EMimageBuffer * redBuf, EMimageBuffer * grnBuf, EMimageBuffer * bluBuf);
@@ -280,6 +280,7 @@ FLOAT_PROP_TEST("MaximumTiltAngle", scope->, MaxTiltAngle)
 FLOAT_PROP_TEST("TiltSpeedFactor", scope->, TiltSpeedFactor)
 FLOAT_PROP_TEST("StageXYSpeedFactor", scope->, StageXYSpeedFactor)
 INT_PROP_TEST("ScopeUpdateInterval", scope->, UpdateInterval)
+FLOAT_PROP_TEST("ScopeCacheAgeFactor", scope->, CacheAgeFactor)
 INT_PROP_TEST("LowDoseBeamNormDelay", scope->, LDBeamNormDelay)
 INT_PROP_TEST("PostProbeDelay", scope->, PostProbeDelay)
 INT_PROP_TEST("PostProbeBeamDelay", scope->, PostProbeBeamDelay)
@@ -425,6 +426,7 @@ FLOAT_PROP_TEST("SkipToScaledRealignMinField", navHelper->, RISkipItemPosMinFiel
 FLOAT_PROP_TEST("MultiInHoleStartAngle", mWinApp->mParticleTasks->, MSinHoleStartAngle)
 FLOAT_PROP_TEST("MultiInHoleOnAxisMinTilt", mWinApp->mParticleTasks->, MSinHoleOnAxisMinTilt)
 BOOL_PROP_TEST("DropPlusInHoleNameIfUtapi", mWinApp->mParticleTasks->, MSDropPlusFromName)
+BOOL_PROP_TEST("MultiShotPipelineParallelTS", mWinApp->mParticleTasks->, MSPipelineParTS)
 FLOAT_PROP_TEST("MultiShotMinTiltForFocus", mWinApp->mParticleTasks->, MSminTiltToCompensate)
 BOOL_PROP_TEST("AllowWindowWithTools", mWinApp->mExternalTools->, AllowWindow)
 FLOAT_PROP_TEST("GridReloadMaxRotation", mWinApp->mMultiGridTasks->, RRGMaxRotation)
@@ -432,7 +434,9 @@ INT_PROP_TEST("MulGridNumMMMcombos", mWinApp->mMultiGridTasks->, NumMMMstateComb
 INT_PROP_TEST("MulGridNumFinalCombos", mWinApp->mMultiGridTasks->, NumFinalStateCombos)
 FLOAT_PROP_TEST("GridReloadMaxCenShift", mWinApp->mMultiGridTasks->, RRGmaxCenShift)
 BOOL_PROP_TEST("MulGridSkipRealign", mWinApp->mMultiGridTasks->, SkipGridRealign)
+INT_PROP_TEST("MulGridMapPrefetchAhead", mWinApp->mMultiGridTasks->, MapPrefetchAhead)
 FLOAT_PROP_TEST("AutocontSubareaSizeFac", navHelper->mAutoContouringDlg->, SingleSizeFac)
+BOOL_PROP_TEST("CombineHolesCheckSerial", navHelper->mCombineHoles->, CheckSerialEval)
 FLOAT_PROP_TEST("GridXformShiftLimit", mWinApp->mMultiGridTasks->, RRGShiftLimitForXform)
 FLOAT_PROP_TEST("GridXformRotationLimit", mWinApp->mMultiGridTasks->, RRGRotLimitForXform)
 FLOAT_PROP_TEST("GridXformResidualLimit", mWinApp->mMultiGridTasks->, RRGResidLimitForXform)
@@ -506,6 +510,7 @@ BOOL_PROP_TEST("RefineZLPLeaveCDSMode", mWinApp->mFilterTasks->, RZlpLeaveCDSmod
 FLOAT_PROP_TEST("EnergyShiftCalMinField", mWinApp->mFilterTasks->, ShiftCalMinField)
 FLOAT_PROP_TEST("GridLinesPerMM", mWinApp->mProcessImage->, GridLinesPerMM)
 INT_PROP_TEST("GridMeshSize", mWinApp->mProcessImage->, GridMeshSize)
+INT_PROP_TEST("PixelSizeSubPatches", mWinApp->mProcessImage->, PixelSubPatches)
 FLOAT_PROP_TEST("TestCtfPixelSize", mWinApp->mProcessImage->, TestCtfPixelSize)
 FLOAT_PROP_TEST("DefaultMaxCtfFitRes", mWinApp->mProcessImage->, DefaultMaxCtfFitRes)
 FLOAT_PROP_TEST("FindBeamOutsideFrac", mWinApp->mProcessImage->, FindBeamOutsideFrac)
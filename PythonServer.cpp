@@ -3,13 +3,15 @@
 #include "PythonServer.h"
 #include "BaseSocket.h"
 #include "MacroProcessor.h"
+#include "Shared\b3dutil.h"
 
 #if defined(_DEBUG) && defined(_CRTDBG_MAP_ALLOC)
 #define new DEBUG_NEW
 #endif
 
 enum { PSS_RegularCommand = 1, PSS_ChunkHandshake, PSS_OKtoRunExternalScript,
-  PSS_GetBufferImage, PSS_PutImageInBuffer};
+  PSS_GetBufferImage, PSS_PutImageInBuffer, PSS_SetupSharedMemory,
+  PSS_GetBufferImageShared, PSS_PutImageInBufferShared, PSS_BatchCommands};
 
 // Table of functions, with # of incoming long, bool, and double, # of outgoing
 // long, bool and double.  The final number is the sum of 1 if there is a long array at
@@ -21,6 +23,10 @@ static ArgDescriptor sFuncTable[] = {
   {PSS_OKtoRunExternalScript,       0, 0, 0,   0, 1, 0,   0, "OKtoRunExternalScript"},
   {PSS_GetBufferImage,              2, 0, 0,   6, 0, 0,   0, "GetBufferImage"},
   {PSS_PutImageInBuffer,            9, 0, 0,   0, 0, 0,   0, "PutImageInBuffer"},
+  {PSS_SetupSharedMemory,           1, 0, 0,   3, 0, 0,   0, "SetupSharedMemory"},
+  {PSS_GetBufferImageShared,        2, 0, 0,   6, 0, 0,   0, "GetBufferImageShared"},
+  {PSS_PutImageInBufferShared,      8, 0, 0,   0, 0, 0,   0, "PutImageInBufferShared"},
+  {PSS_BatchCommands,               2, 0, 0,   3, 0, 0,   3, "BatchCommands"},
   {-1, 0,0,0,0,0,0,0, NULL}
 };
 
@@ -144,10 +150,12 @@ int CPythonServer::ProcessCommand(int sockInd, int numBytes)
   double *dblArr;
   char *strArr;
   long *longArr = NULL;
+  long *record, *newReturn, *batchReturn = NULL;
   KImage *image;
   EMimageBuffer *imBufs;
   char *imArray;
-  int arrSize, numChunks;
+  int arrSize, numChunks, numCmds, recLen, retLen, numDone, numLeft, dataSize, channels;
+  double startTicks;
   bool doSendArgs = true;
   int pnd = sockInd == BKGD_PYSOCK_IND ? 1 : 0;
 
@@ -185,23 +193,7 @@ int CPythonServer::ProcessCommand(int sockInd, int numBytes)
     break;
 
   case PSS_RegularCommand:
-    sScriptData[pnd]->functionCode = longArgs[1];
-    numItems = longArgs[2] + 1;
-    sScriptData[pnd]->lastNonEmptyInd = longArgs[2];
-    dblArr = (double *)(&mLongArray[sockInd][numItems]);
-    strArr = (char *)(&dblArr[numItems]);
-    for (ind = 0; ind < numItems; ind++) {
-      sScriptData[pnd]->itemInt[ind] = mLongArray[sockInd][ind];
-      sScriptData[pnd]->itemDbl[ind] = dblArr[ind];
-      sScriptData[pnd]->strItems[ind] = strArr;
-      strArr += strlen(strArr) + 1;
-    }
-    SEMTrace('[', "Command ready to execute, wait for done event  EC %d",
-      sScriptData[pnd]->externalControl);
-    sScriptData[pnd]->commandReady = 1;
-    while (WaitForSingleObject(CMacroProcessor::mScrpLangDoneEvent[pnd], 1000)) {
-      Sleep(2);
-    }
+    RunRegularCommand(pnd, longArgs[1], longArgs[2], mLongArray[sockInd]);
     longArgs[1] = sScriptData[pnd]->highestReportInd;
     longArgs[2] = sScriptData[pnd]->errorOccurred;
     longArr = AddReturnArrays(lenTot, pnd);
@@ -253,6 +245,144 @@ int CPythonServer::ProcessCommand(int sockInd, int numBytes)
     }
     break;
 
+  // Shared memory transport for images: the client asks for a region of a given size
+  // (0 to stop using it) and gets back the process ID, generation and size, from which
+  // it can compose the name of the region.  After that, images are passed through the
+  // region and only their descriptors go through the socket
+  case PSS_SetupSharedMemory:
+    if (longArgs[1] <= 0) {
+      ReleaseSharedMemory(sockInd);
+      longArgs[1] = longArgs[2] = longArgs[3] = 0;
+    } else if (SetupSharedMemory(sockInd, longArgs[1])) {
+      retSend = -2;
+    } else {
+      longArgs[1] = (long)GetCurrentProcessId();
+      longArgs[2] = mShrMemGeneration[sockInd];
+      longArgs[3] = mShrMemSize[sockInd];
+    }
+    break;
+
+  // Same return as GetBufferImage except for the generation in place of the chunk
+  // count; if it changed, the region was replaced with a bigger one
+  case PSS_GetBufferImageShared:
+    imBufs = longArgs[2] ? mFFTBufs : mImBufs;
+    image = imBufs[longArgs[1]].mImage;
+    longArgs[5] = 0;
+    if (!SharedMemoryActive(sockInd)) {
+      retSend = -7;
+    } else if (image) {
+      longArgs[1] = image->getType();
+      longArgs[2] = image->getRowBytes();
+      longArgs[3] = image->getWidth();
+      longArgs[4] = image->getHeight();
+      longArgs[5] = longArgs[2] * longArgs[4];
+      if (SetupSharedMemory(sockInd, longArgs[5])) {
+        retSend = -2;
+      } else {
+        startTicks = GetTickCount();
+        memcpy(mShrMemView[sockInd], image->getData(), longArgs[5]);
+        longArgs[6] = mShrMemGeneration[sockInd];
+        SEMTrace('K', "PythonServer: copied %d bytes to shared memory in %.0f msec",
+          longArgs[5], SEMTickInterval(startTicks));
+      }
+    }
+    break;
+
+  // Same arguments as PutImageInBuffer without the chunk count; the image must already
+  // be in the shared memory and the array must be big enough for the given size and type
+  case PSS_PutImageInBufferShared:
+    arrSize = longArgs[4];
+    if (!SharedMemoryActive(sockInd) || arrSize <= 0 ||
+      arrSize > mShrMemSize[sockInd] || longArgs[2] <= 0 || longArgs[3] <= 0 ||
+      dataSizeForMode(longArgs[1], &dataSize, &channels) < 0 ||
+      (__int64)longArgs[2] * longArgs[3] * dataSize * channels > arrSize) {
+      retSend = -7;
+      break;
+    }
+    NewArray(imArray, char, arrSize);
+    if (!imArray) {
+      retSend = -2;
+      break;
+    }
+    mImType = longArgs[1];
+    mImSizeX = longArgs[2];
+    mImSizeY = longArgs[3];
+    mImToBuf = longArgs[5];
+    mImBaseBuf = longArgs[6];
+    mMoreBinning = longArgs[7];
+    mCapFlag = longArgs[8];
+    memcpy(imArray, mShrMemView[sockInd], arrSize);
+    doSendArgs = false;
+    if (SendArgsBack(sockInd, 0)) {
+      delete[] imArray;
+    } else {
+      mImArray = imArray;
+      while (WaitForSingleObject(CMacroProcessor::mScrpLangDoneEvent[pnd], 1000))
+        Sleep(2);
+    }
+    break;
+
+  // A batch of regular commands in one packet.  The long array has for each command:
+  // the number of longs in its record (including this one), the function code, the
+  // last non-empty index, then the same array as for a regular command padded to a long
+  // boundary.  The returned array has for each command that was run: the record
+  // length, the highest report index, the error flag, then the arrays returned by a
+  // regular command.  Commands stop at the first error; the number run is returned
+  case PSS_BatchCommands:
+    numCmds = longArgs[1];
+    numLeft = longArgs[2];
+    record = mLongArray[sockInd];
+    numDone = 0;
+    lenTot = 0;
+    startTicks = GetTickCount();
+    for (ind = 0; ind < numCmds; ind++) {
+      recLen = record[0];
+      if (recLen < 3 || recLen > numLeft || !BatchRecordIsValid(record, recLen)) {
+        retSend = -6;
+        break;
+      }
+      RunRegularCommand(pnd, record[1], record[2], &record[3]);
+      longArr = AddReturnArrays(retLen, pnd);
+      if (!longArr) {
+        retSend = -2;
+        break;
+      }
+
+      // Append this result to the accumulated results
+      newReturn = (long *)realloc(batchReturn, (lenTot + retLen + 3) * sizeof(long));
+      if (!newReturn) {
+        retSend = -2;
+        break;
+      }
+      batchReturn = newReturn;
+      batchReturn[lenTot] = retLen + 3;
+      batchReturn[lenTot + 1] = sScriptData[pnd]->highestReportInd;
+      batchReturn[lenTot + 2] = sScriptData[pnd]->errorOccurred;
+      memcpy(&batchReturn[lenTot + 3], longArr, retLen * sizeof(long));
+      lenTot += retLen + 3;
+      free(longArr);
+      longArr = NULL;
+      numDone++;
+      if (sScriptData[pnd]->errorOccurred)
+        break;
+      numLeft -= recLen;
+      record += recLen;
+    }
+    if (!retSend) {
+      longArgs[1] = numDone;
+      longArgs[2] = numCmds;
+      longArgs[3] = lenTot;
+      mLongArray[sockInd] = batchReturn;
+      SEMTrace('[', "Ran batch of %d of %d commands in %.0f msec", numDone, numCmds,
+        SEMTickInterval(startTicks));
+    }
+
+    // The results are local to this call so that channels do not share them; they are
+    // freed below after being sent
+    free(longArr);
+    longArr = batchReturn;
+    break;
+
   default:
     retSend = -1;  // Incorrect command
     break;
@@ -263,6 +393,50 @@ int CPythonServer::ProcessCommand(int sockInd, int numBytes)
   return 0;
 }
 
+// Check that a record in a batch of commands has a valid number of items and holds all
+// of the longs, doubles and strings for them within its length
+bool CPythonServer::BatchRecordIsValid(long *record, int recLen)
+{
+  int ind, numItems = record[2] + 1;
+  char *strArr, *recEnd = (char *)(&record[recLen]);
+  if (record[2] < 0 || record[2] >= MAX_SCRIPT_LANG_ARGS)
+    return false;
+  strArr = (char *)(&record[3 + numItems]) + numItems * sizeof(double);
+  for (ind = 0; ind < numItems; ind++) {
+    if (strArr >= recEnd)
+      return false;
+    strArr = (char *)memchr(strArr, 0, recEnd - strArr);
+    if (!strArr)
+      return false;
+    strArr++;
+  }
+  return true;
+}
+
+// Load the arguments for a regular command into the script data and wait for the
+// command to be run
+void CPythonServer::RunRegularCommand(int pnd, long funcCode, long lastNonEmpty,
+  long *longArray)
+{
+  int ind, numItems = lastNonEmpty + 1;
+  double *dblArr = (double *)(&longArray[numItems]);
+  char *strArr = (char *)(&dblArr[numItems]);
+  sScriptData[pnd]->functionCode = funcCode;
+  sScriptData[pnd]->lastNonEmptyInd = lastNonEmpty;
+  for (ind = 0; ind < numItems; ind++) {
+    sScriptData[pnd]->itemInt[ind] = longArray[ind];
+    sScriptData[pnd]->itemDbl[ind] = dblArr[ind];
+    sScriptData[pnd]->strItems[ind] = strArr;
+    strArr += strlen(strArr) + 1;
+  }
+  SEMTrace('[', "Command ready to execute, wait for done event  EC %d",
+    sScriptData[pnd]->externalControl);
+  sScriptData[pnd]->commandReady = 1;
+  while (WaitForSingleObject(CMacroProcessor::mScrpLangDoneEvent[pnd], 1000)) {
+    Sleep(2);
+  }
+}
+
 long *CPythonServer::AddReturnArrays(int &lenTot, int pnd)
 {
   int numLongs = sScriptData[pnd]->highestReportInd + 1;
@@ -11,6 +11,9 @@ public:
   void ShutdownSocketIfOpen(int sockInd);
   static int ProcessCommand(int sockInd, int numExpected);
   static long *AddReturnArrays(int &lenTot, int pnd);
+  static void RunRegularCommand(int pnd, long funcCode, long lastNonEmpty,
+    long *longArray);
+  static bool BatchRecordIsValid(long *record, int recLen);
   static void TryToStartExternalControl(void);
   static int mImType;
   static int mImSizeX;
@@ -133,13 +133,29 @@ IDD_STEMCONTROL, IDD_FILTERCONTROL, IDD_DETOOLDLG, IDD_DECTRIS_TOOLDLG};
 // Static variable for com and other errors to be reported in, watched by OnIdle
 static int sThreadError = 0;
 
-// A mutex and static data for trace output to log window
-static HANDLE traceMutexHandle;
-#define TRACE_MUTEX_WAIT  1000
-#define MAX_TRACE_LIST 20
-static CString sTraceMsg[MAX_TRACE_LIST];
-static bool sTraceIsDebug[MAX_TRACE_LIST];
-static int sNumTraceMsg = 0;
+// A ring buffer of trace records for output to log window and/or file.  Any thread can
+// claim a slot by advancing the write index with a compare-exchange; a slot is ready to
+// be read when its sequence is one past its position, and free for writing when its
+// sequence equals its position.  Only the main thread reads records.  Text too long for
+// the slot is placed in an allocated string that the reader frees
+#define TRACE_RING_SIZE  1024
+#define TRACE_TEXT_SIZE  240
+struct TraceRecord {
+  volatile LONG sequence;
+  double timeStamp;
+  DWORD threadID;
+  char key;
+  char *longText;
+  char text[TRACE_TEXT_SIZE];
+};
+static TraceRecord sTraceRing[TRACE_RING_SIZE];
+static volatile LONG sTraceWriteInd = 0;
+static LONG sTraceReadInd = 0;
+static volatile LONG sNumTraceDropped = 0;
+static int sTraceFileMode = 0;
+static CString sTraceFileName;
+static FILE *sTraceFile = NULL;
+static void FlushTraceRecords(CSerialEMApp *winApp);
 static double sStartTime;
 static CString debugOutput = "";
 static DWORD appThreadID;
@@ -154,6 +170,15 @@ static void(__cdecl *sReviseITOFunc)(int) = NULL;
 static int sReviseITOSource = 0;
 static DWORD sRevisedIdleTimeout;
 
+// Event and data for worker threads to signal completion to the idle task manager
+static HANDLE sTaskDoneEvent = NULL;
+static volatile LONG sTaskDonePending = 0;
+static volatile LONG sTaskDoneCount = 0;
+static double sTaskDoneTime = 0.;
+static CRITICAL_SECTION sTaskDoneCS;
+#define TASK_DONE_STALE_MSEC  50.
+#define TASK_LATENCY_REPORT_INTERVAL  100
+
 CComModule _Module;
 
 /////////////////////////////////////////////////////////////////////////////
@@ -871,7 +896,10 @@ CSerialEMApp::CSerialEMApp()
   mNeedMultiChan = 0;
   mMaxChannelBuffers = 3;
   mCircleTypesInLDDefine = -2;
-  traceMutexHandle = CreateMutex(0, 0, 0);
+  for (i = 0; i < TRACE_RING_SIZE; i++)
+    sTraceRing[i].sequence = i;
+  sTaskDoneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+  InitializeCriticalSection(&sTaskDoneCS);
   sStartTime = GetTickCount();
   mLastIdleScriptTime = sStartTime;
   mLastActivityTime = sStartTime;
@@ -961,6 +989,9 @@ CSerialEMApp::~CSerialEMApp()
   delete mPluginManager;
   for (int i = 0; i < mIdleArray.GetSize(); i++)
     delete mIdleArray[i];
+  if (sTaskDoneEvent)
+    CloseHandle(sTaskDoneEvent);
+  DeleteCriticalSection(&sTaskDoneCS);
   KStoreADOC::AllDone();
 }
 /////////////////////////////////////////////////////////////////////////////
@@ -1969,6 +2000,9 @@ int CSerialEMApp::ExitInstance()
 
   if (mComModuleInited)
   	_Module.Term();
+  if (sTraceFile)
+    fclose(sTraceFile);
+  sTraceFile = NULL;
   return CWinApp::ExitInstance();
 }
 
@@ -2946,6 +2980,7 @@ void CSerialEMApp::AddIdleTask(int (__cdecl *busyFunc)(void), void (__cdecl *nex
   idc->source = source;
   idc->param = param;
   idc->extendTimeOut = timeOut > 0;
+  idc->signalTime = 0.;
   mLastCheckTime = GetTickCount();
   if (source == TASK_BKGD_MACRO)
     RemoveIdleTask(TASK_BKGD_MACRO);
@@ -2988,16 +3023,71 @@ void CSerialEMApp::ReviseIdleTaskTimeout(void(__cdecl *nextFunc)(int), int sourc
       newTimeOut);
 }
 
+// Called from a worker thread when it is about to finish: records the time and wakes up
+// the idle loop, or posts a timer message if running on a timer, so that the task
+// waiting on the thread is checked and the next one dispatched without waiting to poll
+void SEMSignalTaskDone()
+{
+  EnterCriticalSection(&sTaskDoneCS);
+  sTaskDoneTime = wallTime();
+  LeaveCriticalSection(&sTaskDoneCS);
+  InterlockedIncrement(&sTaskDoneCount);
+  InterlockedExchange(&sTaskDonePending, 1);
+  if (sTaskDoneEvent)
+    SetEvent(sTaskDoneEvent);
+#ifdef TASK_TIMER_INTERVAL
+  CSerialEMApp *winApp = (CSerialEMApp *)AfxGetApp();
+  if (winApp->mMainFrame)
+    winApp->mMainFrame->PostMessage(WM_TIMER, ID_TASK_TIMER, 0);
+#endif
+}
+
+// Get the time of the last completion signal, which is set from multiple threads
+static double GetTaskDoneTime()
+{
+  double doneTime;
+  EnterCriticalSection(&sTaskDoneCS);
+  doneTime = sTaskDoneTime;
+  LeaveCriticalSection(&sTaskDoneCS);
+  return doneTime;
+}
+
+// Output the statistics on latency from completion signal to dispatch, optionally reset
+void CSerialEMApp::ReportTaskLatencies(bool reset)
+{
+  std::map<int, TaskLatencyStats>::iterator iter;
+  if (!mTaskLatencies.size()) {
+    PrintfToLog("No task dispatch latencies have been recorded");
+    return;
+  }
+  PrintfToLog("Task dispatch latencies after completion signal (msec):");
+  for (iter = mTaskLatencies.begin(); iter != mTaskLatencies.end(); iter++) {
+    if (iter->first < 0)
+      PrintfToLog("  Function-based tasks: %d  mean %.2f  max %.2f",
+        iter->second.numDispatched, iter->second.sum / iter->second.numDispatched,
+        iter->second.max);
+    else
+      PrintfToLog("  Task source %d: %d  mean %.2f  max %.2f", iter->first,
+        iter->second.numDispatched, iter->second.sum / iter->second.numDispatched,
+        iter->second.max);
+  }
+  if (reset)
+    mTaskLatencies.clear();
+}
+
 // Check the idle tasks, return true if any are still running
 BOOL CSerialEMApp::CheckIdleTasks()
 {
   BOOL bRtn = FALSE;
-  int i, busy = 0;
+  int i, busy = 0, latencyKey;
   IdleCallBack *idc;
   DWORD time = GetTickCount();
   static DWORD maxInt = 0;
+  static int numSinceReport = 0;
+  static LONG lastDoneCount = 0;
   DWORD interval = 0;
   bool bkgdMacroIsOnlyTask = false;
+  double latency, doneTime;
 
   if (mRestoreFocusIdleCount) {
     mRestoreFocusIdleCount--;
@@ -3023,16 +3113,7 @@ BOOL CSerialEMApp::CheckIdleTasks()
   }
 
   // Dump debug output to log window
-  if (debugOutput &&
-    (WaitForSingleObject(traceMutexHandle, TRACE_MUTEX_WAIT) == WAIT_OBJECT_0)) {
-    for (i = 0; i < sNumTraceMsg; i++) {
-      if (sTraceIsDebug[i])
-        SetNextLogColorStyle(DEBUG_COLOR_IND, 0);
-      AppendToLog(sTraceMsg[i], LOG_OPEN_IF_CLOSED);
-    }
-    sNumTraceMsg = 0;
-    ReleaseMutex(traceMutexHandle);
-  }
+  FlushTraceRecords(this);
 
   if (mIdleArray.GetSize())
     mLastActivityTime = time;
@@ -3087,6 +3168,16 @@ BOOL CSerialEMApp::CheckIdleTasks()
     sReviseITOSource = 0;
   }
 
+  // If there has been a completion signal since the last check, stamp its time into
+  // every waiting task, so each one gets the latency from the last signal before it is
+  // dispatched
+  if (sTaskDoneCount != lastDoneCount) {
+    lastDoneCount = sTaskDoneCount;
+    doneTime = GetTaskDoneTime();
+    for (i = 0; i < mIdleArray.GetSize(); i++)
+      mIdleArray[i]->signalTime = doneTime;
+  }
+
   // Look through the list of tasks if any
   for (i = 0; i < mIdleArray.GetSize(); i++) {
     // Return TRUE if there is anything on list
@@ -3191,6 +3282,30 @@ BOOL CSerialEMApp::CheckIdleTasks()
         // Delete task from array now, to prevent multiple deletion
         mIdleArray.RemoveAt(i);
 
+      // If a worker signaled completion while this task waited, accumulate the latency
+      // to its dispatch
+      if (!busy)
+        InterlockedExchange(&sTaskDonePending, 0);
+      if (!busy && idc->signalTime > 0.) {
+        latency = 1000. * (wallTime() - idc->signalTime);
+        latencyKey = idc->nextFunc ? -1 : idc->source;
+        if (!mTaskLatencies.count(latencyKey)) {
+          mTaskLatencies[latencyKey].numDispatched = 0;
+          mTaskLatencies[latencyKey].sum = 0.;
+          mTaskLatencies[latencyKey].max = 0.;
+        }
+        TaskLatencyStats &stats = mTaskLatencies[latencyKey];
+        stats.numDispatched++;
+        stats.sum += latency;
+        ACCUM_MAX(stats.max, latency);
+        SEMTrace('o', "Task %d dispatched %.2f msec after completion", latencyKey,
+          latency);
+        if (GetDebugOutput('o') && ++numSinceReport >= TASK_LATENCY_REPORT_INTERVAL) {
+          numSinceReport = 0;
+          ReportTaskLatencies(false);
+        }
+      }
+
       // Otherwise, if OK, call next func with parameter,
       // or if error, call error function with return code if it exists
       // or if timeout, call error function with that code
@@ -3491,6 +3606,10 @@ BOOL CSerialEMApp::CheckIdleTasks()
   }
   ManageBlinkingPane(time);
 
+  // Stop the fast polling for a completion signal that did not lead to a dispatch
+  if (sTaskDonePending && 1000. * (wallTime() - GetTaskDoneTime()) > TASK_DONE_STALE_MSEC)
+    InterlockedExchange(&sTaskDonePending, 0);
+
   return bRtn;
 }
 
@@ -3504,14 +3623,21 @@ BOOL CSerialEMApp::OnIdle(LONG lCount)
   // Let the base class finish its tasks, as recommended usage
   // Except occasionally, sneak a cycle
   // (but when camera acquire is already done, it sets the count high to go right away)
+  // Also go right away if a worker thread has signaled completion
   mIdleBaseCount++;
-  if (bIdle && mIdleBaseCount < 100)
+  if (bIdle && mIdleBaseCount < 100 && !sTaskDonePending)
     return TRUE;
   mIdleBaseCount = 0;
 
   // Sleeping 1 is enough to keep it from eating lots of CPU during acquires, the average
   // tick count change during the sleep is only 1 ms longer than the sleep time
-  Sleep(2);
+  // Instead of sleeping, wait for the same time on the completion event or a message, but
+  // sleep the minimum if completion is pending because the thread may not have exited yet
+  if (sTaskDonePending)
+    Sleep(1);
+  else if (!sTaskDoneEvent || MsgWaitForMultipleObjects(1, &sTaskDoneEvent, FALSE, 2,
+    QS_ALLINPUT) == WAIT_FAILED)
+    Sleep(2);
   return CheckIdleTasks() || bIdle;
 #endif
 }
@@ -4012,57 +4138,148 @@ bool DLL_IM_EX SEMIsIgnoringFunctionCalled()
 //   l for low dose
 //   m to output all SEMMessageBox messages to log
 //   n for Navigator
+//   o for latency from thread completion to dispatch of next task
 //   p for AlignWithScaling and FindBeamCenter output
 //   r for references
 //   s for STEM in general
 //   t for exposure time/intensity changes in tasks and continuous timing
 //   u for updates
 //   w for JEOL stage wait
-//   y for background save start/end reports
+//   y for background save start/end reports and save throughput
 //   % list script commands allowing arithmetic
 //   } Crash program on next image acquire
 //   ! @ # $ used for special debug levels
 void SEMTrace(char key, char *fmt, ...)
 {
   va_list args;
-  CString str;
   CString specKeys = "!@#$";
   CSerialEMApp *winApp = (CSerialEMApp *)AfxGetApp();
   int special = winApp->GetSpecialDebugLevel();
   int keyInd = specKeys.Find(key);
+  char buf[TRACE_TEXT_SIZE];
+  char *longText = NULL;
+  TraceRecord *rec;
+  LONG pos, diff;
+  int len;
   if ((debugOutput.IsEmpty() || debugOutput == "0" ||
     (key != '1' && debugOutput.Find(key) < 0)) && key != '0' &&
     (keyInd < 0 || special <= keyInd))
     return;
-  if (WaitForSingleObject(traceMutexHandle, TRACE_MUTEX_WAIT) != WAIT_OBJECT_0)
-    return;
 
-  if (sNumTraceMsg >= MAX_TRACE_LIST)
-    sNumTraceMsg = MAX_TRACE_LIST - 1;
+  // Format the text before claiming a slot so the reader is not held up
+  va_start(args, fmt);
+  len = _vscprintf(fmt, args);
+  va_end(args);
+  if (len < 0)
+    len = 0;
 
-  sTraceIsDebug[sNumTraceMsg] = key != '0';
-  if (key == '0')
-    sTraceMsg[sNumTraceMsg] = "";
-  else
-    sTraceMsg[sNumTraceMsg].Format("%.3f: ", SEMSecondsSinceStart());
+  // Restart the list since it was consumed in getting the length
   va_start(args, fmt);
-  VarArgToCString(str, fmt, args);
+  if (len < TRACE_TEXT_SIZE) {
+    vsprintf_s(buf, TRACE_TEXT_SIZE, fmt, args);
+  } else {
+    longText = (char *)malloc(len + 1);
+    if (longText)
+      vsprintf_s(longText, len + 1, fmt, args);
+    else
+      buf[0] = 0x00;
+  }
   va_end(args);
-  sTraceMsg[sNumTraceMsg++] += str;
+
+  // Claim the next slot, or drop the message if the ring is full
+  pos = sTraceWriteInd;
+  for (;;) {
+    rec = &sTraceRing[pos & (TRACE_RING_SIZE - 1)];
+    diff = (LONG)((ULONG)rec->sequence - (ULONG)pos);
+    if (!diff) {
+      if (InterlockedCompareExchange(&sTraceWriteInd, pos + 1, pos) == pos)
+        break;
+      pos = sTraceWriteInd;
+    } else if (diff < 0) {
+      InterlockedIncrement(&sNumTraceDropped);
+      B3DFREE(longText);
+      return;
+    } else {
+      pos = sTraceWriteInd;
+    }
+  }
+
+  rec->timeStamp = SEMSecondsSinceStart();
+  rec->threadID = GetCurrentThreadId();
+  rec->key = key;
+  rec->longText = longText;
+  if (!longText)
+    memcpy(rec->text, buf, B3DMIN(len + 1, TRACE_TEXT_SIZE));
+  InterlockedExchange(&rec->sequence, pos + 1);
 
   // If this is the main thread, dump the output immediately
-  if (GetCurrentThreadId() == appThreadID && winApp->mLogWindow) {
-    for (int len = 0; len < sNumTraceMsg; len++) {
-      if (sTraceIsDebug[len])
-        winApp->SetNextLogColorStyle(DEBUG_COLOR_IND, 0);
-      winApp->AppendToLog(sTraceMsg[len], LOG_OPEN_IF_CLOSED);
+  if (rec->threadID == appThreadID && winApp->mLogWindow)
+    FlushTraceRecords(winApp);
+}
+
+// Output all ready trace records to the log window and/or file; main thread only
+static void FlushTraceRecords(CSerialEMApp *winApp)
+{
+  TraceRecord *rec;
+  CString str;
+  LONG numDropped;
+  int numOut = 0;
+  bool toLog = sTraceFileMode < 2 || sTraceFileName.IsEmpty();
+  bool toFile = sTraceFileMode > 0 && !sTraceFileName.IsEmpty();
+  if (GetCurrentThreadId() != appThreadID)
+    return;
+  if (toFile && !sTraceFile) {
+    if (fopen_s(&sTraceFile, (LPCTSTR)sTraceFileName, "a"))
+      sTraceFile = NULL;
+    if (!sTraceFile) {
+      sTraceFileMode = 0;
+      toFile = false;
+      toLog = true;
+      winApp->AppendToLog("Could not open file for debug output: " + sTraceFileName,
+        LOG_OPEN_IF_CLOSED);
     }
-    sNumTraceMsg = 0;
-    if (debugOutput.Find('A') >= 0)
-      winApp->mLogWindow->UpdateSaveFile(false);
   }
 
-  ReleaseMutex(traceMutexHandle);
+  for (;;) {
+    rec = &sTraceRing[sTraceReadInd & (TRACE_RING_SIZE - 1)];
+    if (rec->sequence != sTraceReadInd + 1)
+      break;
+    const char *text = rec->longText ? rec->longText : rec->text;
+    if (toFile)
+      fprintf(sTraceFile, "%.3f %5u %c: %s\n", rec->timeStamp,
+        (unsigned int)rec->threadID, rec->key, text);
+    if (toLog) {
+      if (rec->key == '0') {
+        str = text;
+      } else {
+        str.Format("%.3f: ", rec->timeStamp);
+        str += text;
+        winApp->SetNextLogColorStyle(DEBUG_COLOR_IND, 0);
+      }
+      winApp->AppendToLog(str, LOG_OPEN_IF_CLOSED);
+    }
+    B3DFREE(rec->longText);
+    InterlockedExchange(&rec->sequence, sTraceReadInd + TRACE_RING_SIZE);
+    sTraceReadInd++;
+    numOut++;
+  }
+
+  numDropped = InterlockedExchange(&sNumTraceDropped, 0);
+  if (numDropped) {
+    str.Format("WARNING: %d debug output messages were dropped because the buffer was "
+      "full", numDropped);
+    if (toFile)
+      fprintf(sTraceFile, "%s\n", (LPCTSTR)str);
+    if (toLog)
+      winApp->AppendToLog(str, LOG_OPEN_IF_CLOSED);
+    numOut++;
+  }
+  if (!numOut)
+    return;
+  if (toFile)
+    fflush(sTraceFile);
+  if (toLog && winApp->mLogWindow && debugOutput.Find('A') >= 0)
+    winApp->mLogWindow->UpdateSaveFile(false);
 }
 
 // Safely print a message into a buffer and return it in the CString argumemt
@@ -4114,6 +4331,17 @@ CString CSerialEMApp::GetDebugKeys(void)
   return debugOutput;
 }
 
+// Set file for debug output; mode 1 writes to log and file, 2 writes only to the file
+void CSerialEMApp::SetDebugOutputFile(int mode, CString &name)
+{
+  if (sTraceFile && name != sTraceFileName) {
+    fclose(sTraceFile);
+    sTraceFile = NULL;
+  }
+  sTraceFileMode = mode;
+  sTraceFileName = name;
+}
+
 
 ////////////////////////////////////////////////////////////////////////
 // FUNCTIONS FOR INTERACTIONS WITH CONTROL PANELS, MAIN FRAME ETC
@@ -4385,7 +4613,8 @@ BOOL CSerialEMApp::DoingTasks()
     mShiftManager->ResettingIS() || mParticleTasks->GetDVDoingDewarVac() ||
     mScope->CalibratingNeutralIS() || mBeamAssessor->CalibratingIAlimits() ||
     mScope->GetDoingLongOperation() || mMultiTSTasks->DoingBidirCopy() > 0 ||
-    (mNavigator && (mNavigator->GetLoadingMap() || mNavigator->DoingNewFileRange())) ||
+    (mNavigator && (mNavigator->GetLoadingMap() || mNavigator->DoingNewFileRange() ||
+    mNavigator->GetLoadingNavFile())) || mMultiGridTasks->GetLoadingAllMaps() ||
     (mShowRemoteControl && mRemoteControl.GetDoingTask()) ||
     (mNavHelper->mHoleFinderDlg && mNavHelper->mHoleFinderDlg->GetFindingHoles()) ||
     (mPlugDoingFunc && mPlugDoingFunc()) || CSerialEMView::GetTakingSnapshot() ||
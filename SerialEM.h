@@ -438,6 +438,14 @@ struct IdleCallBack {
   int param;                        // One parameter to pass
   DWORD timeOut;                    // if not = 0, timeout in millisec
   BOOL extendTimeOut;               // Flag to extend timeouts after long intervals
+  double signalTime;                // Time of last completion signal while waiting, or 0
+};
+
+// Statistics on time from a worker thread signaling completion to dispatch of next task
+struct TaskLatencyStats {
+  int numDispatched;                // Number of signaled completions dispatched
+  double sum;                       // Sum of latencies in msec
+  double max;                       // Maximum latency
 };
 
 struct LensRelaxData {
@@ -456,6 +464,7 @@ BOOL DLL_IM_EX SEMTestHResult(HRESULT hr, CString inString, CString *outStr = NU
                     int *errFlag = NULL, bool skipErr = false);
 int DLL_IM_EX SEMStageCameraBusy();
 void DLL_IM_EX SEMTrace(char key, char *fmt, ...);
+void DLL_IM_EX SEMSignalTaskDone();
 void VarArgToCString(CString &str, char *fmt, va_list args);
 void DLL_IM_EX PrintfToLog(char *fmt, ...);
 BOOL DLL_IM_EX GetDebugOutput(char key);
@@ -989,6 +998,7 @@ private:
   BOOL mProcessHere;                   // Global default flag for processing here
 
   CArray<IdleCallBack *, IdleCallBack *> mIdleArray;
+  std::map<int, TaskLatencyStats> mTaskLatencies;  // Dispatch latencies by task source
   CString mMacros[MAX_TOT_MACROS];
   MacroControl mMacControl;
   CString mExePath;           // Path to executable;
@@ -1141,6 +1151,7 @@ public:
   void InitializeLDParams(void);
   void InitializeOneLDParam(LowDoseParams &ldParam);
   CString GetDebugKeys(void);
+  void SetDebugOutputFile(int mode, CString &name);
   int AddToStackView(EMimageBuffer * imBuf, int angleOrder);
   void ViewClosing(BOOL stackView, BOOL FFTview, int multiChan, CSerialEMView *view);
   void DetachStackView(void);
@@ -1174,6 +1185,7 @@ public:
   CString BinningText(int binning, CameraParameters *camParam);
   void RestoreCameraForExit(void);
   void RemoveIdleTask(int source);
+  void ReportTaskLatencies(bool reset);
   static void ReviseIdleTaskTimeout(void(__cdecl *nextFunc)(int), int source, int newTimeOut);
   EMimageBuffer * GetActiveNonStackImBuf(void);
   PlugStopFunc RegisterPlugStopFunc(PlugStopFunc func);
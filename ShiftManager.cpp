@@ -40,6 +40,8 @@
 #define new DEBUG_NEW
 #endif
 
+#define MAX_CCC_THREADS 8
+
 static void AlignRightDblClickImage();
 
 
@@ -107,6 +109,12 @@ CShiftManager::CShiftManager()
   mStageStretchXform.xpx = 0.;
   mTmplImage = NULL;
   mNextAutoalignLimit = -1.;
+  mKeepRefSpectrum = false;
+  mChainRefSpectrum = false;
+  mRefSpecSize = 0;
+  mRefSpectrum = NULL;
+  mRefFiltered = NULL;
+  mRefSpecImage = NULL;
   mLastTimeoutWasIS = false;
   mBacklashMouseAndISR = false;
   mStageInvertsZAxis = -1;
@@ -123,7 +131,7 @@ CShiftManager::CShiftManager()
 
 CShiftManager::~CShiftManager()
 {
-
+  SetKeepRefSpectrum(false);
 }
 
 // Further initialization of program component addresses
@@ -579,7 +587,12 @@ int CShiftManager::AutoAlign(int bufIndex, int inSmallPad, BOOL doImShift, int c
                              float *yShiftOut, float probSigma)
 {
   BOOL doTrim, swapStretch;
-  int nxUse, nxPad, nyUse, nyPad;
+  bool stretchedC = false, keepRef, useKeptRef, preEval, chainRef;
+  int nxUse, nxPad, nyUse, nyPad, ind, jPeak, numThreads, refKey[10];
+  int nxTaperA, nyTaperA;
+  size_t arrBytes;
+  FloatVec altCCC;
+  IntVec altNumPix;
   int needBinA, needBinC;
   int nxTaper, nyTaper, nyTrimCtop;
   int nxTrimA, nyTrimA, nxTrimC, nyTrimC, nxTrimAright, nyTrimAtop, nxTrimCright;
@@ -909,6 +922,7 @@ int CShiftManager::AutoAlign(int bufIndex, int inSmallPad, BOOL doImShift, int c
     //if (typeC == kUBYTE)
       //typeC = kSHORT;
     mDeleteC = true;
+    stretchedC = true;
 
 
   }
@@ -1154,6 +1168,8 @@ int CShiftManager::AutoAlign(int bufIndex, int inSmallPad, BOOL doImShift, int c
   frac = mTaperFrac / (1.f - 2.f * trimFrac);
   nxTaper = (int)(frac * nxUseA);
   nyTaper = (int)(frac * nyUseA);
+  nxTaperA = nxTaper;
+  nyTaperA = nyTaper;
   XCorrTaperInPad(fillArray ? fillArray : mDataA, fillArray ? SLICE_MODE_FLOAT : typeA,
     widthA, ix0A, ix1A, iy0A, iy1A, mArray, nxPad + 2, nxPad, nyPad, nxTaper, nyTaper);
 
@@ -1164,13 +1180,83 @@ int CShiftManager::AutoAlign(int bufIndex, int inSmallPad, BOOL doImShift, int c
     nxTaper = (int)(frac * nxUseC);
     nyTaper = (int)(frac * nyUseC);
   }
-  XCorrTaperInPad(fillArray ? fillBrray : mDataC, fillArray ? SLICE_MODE_FLOAT: typeC,
-    widthC, ix0C, ix1C, iy0C, iy1C, mBrray, nxPad + 2, nxPad, nyPad, nxTaper, nyTaper);
+
+  // See if a kept reference spectrum can be used: the reference must be unmodified and
+  // padded the same way
+  refKey[0] = nxPad;
+  refKey[1] = nyPad;
+  refKey[2] = ix0C;
+  refKey[3] = ix1C;
+  refKey[4] = iy0C;
+  refKey[5] = iy1C;
+  refKey[6] = nxTaper;
+  refKey[7] = nyTaper;
+  refKey[8] = needBinC;
+  refKey[9] = toBuf;
+  keepRef = mKeepRefSpectrum && !fillArray && !stretchedC && !autoCorr && !tmplCorr;
+  useKeptRef = keepRef && mRefSpectrum && mRefSpecImage == mImC &&
+    mRefSpecTimeStamp == mImBufs[toBuf].mTimeStamp && mRefSpecDelta == delta &&
+    !memcmp(refKey, mRefSpecKey, sizeof(refKey)) &&
+    (!delta || !memcmp(mCTFa, mRefSpecCTF, sizeof(mCTFa)));
+  if (!useKeptRef)
+    XCorrTaperInPad(fillArray ? fillBrray : mDataC, fillArray ? SLICE_MODE_FLOAT : typeC,
+      widthC, ix0C, ix1C, iy0C, iy1C, mBrray, nxPad + 2, nxPad, nyPad, nxTaper, nyTaper);
 
   if (debugTime)
     time3 = wallTime() * 1000.;
 
-  XCorrCrossCorr(mBrray, mArray, nxPad, nyPad, delta, mCTFa, mCrray);
+  if (keepRef) {
+
+    // Do the steps of XCorrCrossCorr separately so that the filtered reference spectrum
+    // and filtered reference are computed only once
+    arrBytes = (size_t)(nxPad + 2) * nyPad * sizeof(float);
+    if (useKeptRef) {
+      memcpy(mBrray, mRefSpectrum, arrBytes);
+      memcpy(mCrray, mRefFiltered, arrBytes);
+    } else {
+      XCorrMeanZero(mBrray, nxPad + 2, nxPad, nyPad);
+      todfftc(mBrray, nxPad, nyPad, 0);
+      if (delta)
+        XCorrFilterPart(mBrray, mBrray, nxPad, nyPad, mCTFa, delta);
+      memcpy(mCrray, mBrray, arrBytes);
+      todfftc(mCrray, nxPad, nyPad, 1);
+      if (!mChainRefSpectrum && AllocRefSpectrum(arrBytes / sizeof(float))) {
+        memcpy(mRefSpectrum, mBrray, arrBytes);
+        memcpy(mRefFiltered, mCrray, arrBytes);
+        StoreRefSpecKeys(refKey, delta, mImC, mImBufs[toBuf].mTimeStamp);
+      }
+    }
+    todfftc(mArray, nxPad, nyPad, 0);
+    if (delta)
+      XCorrFilterPart(mArray, mArray, nxPad, nyPad, mCTFa, delta);
+
+    // When chaining, this spectrum is the reference for the next alignment after the
+    // image rolls into the reference buffer; zeroing its DC term is equivalent to the
+    // mean-zeroing done for a reference
+    chainRef = mChainRefSpectrum && !transformedA &&
+      AllocRefSpectrum(arrBytes / sizeof(float));
+    if (chainRef) {
+      memcpy(mRefSpectrum, mArray, arrBytes);
+      mRefSpectrum[0] = mRefSpectrum[1] = 0.;
+    }
+    conjugateProduct(mBrray, mArray, nxPad, nyPad);
+    todfftc(mBrray, nxPad, nyPad, 1);
+    todfftc(mArray, nxPad, nyPad, 1);
+    if (chainRef) {
+      memcpy(mRefFiltered, mArray, arrBytes);
+      XCorrMeanZero(mRefFiltered, nxPad + 2, nxPad, nyPad);
+      refKey[2] = ix0A;
+      refKey[3] = ix1A;
+      refKey[4] = iy0A;
+      refKey[5] = iy1A;
+      refKey[6] = nxTaperA;
+      refKey[7] = nyTaperA;
+      refKey[8] = needBinA;
+      StoreRefSpecKeys(refKey, delta, mImA, mImBufs->mTimeStamp);
+    }
+  } else {
+    XCorrCrossCorr(mBrray, mArray, nxPad, nyPad, delta, mCTFa, mCrray);
+  }
 
   DELETE_ARR(fillArray);
   DELETE_ARR(fillBrray);
@@ -1216,6 +1302,37 @@ int CShiftManager::AutoAlign(int bufIndex, int inSmallPad, BOOL doImShift, int c
   // Loop through the peaks, evaluating the CCC at each of the 4 alternative actual shifts
   indMaxPeak = 0;
   minPixel = 0.05 * B3DMIN(nxUseA, nxUseC) * B3DMIN(nyUseA, nyUseC);
+
+  // Compute these CCCs in parallel first unless peaks may be removed in the loop
+  preEval = !mWinApp->mShiftCalibrator->CalibratingIS() && numPeaks > 1;
+  if (preEval) {
+    altCCC.resize(4 * numPeaks);
+    altNumPix.resize(4 * numPeaks);
+    numThreads = B3DMIN(4 * numPeaks, MAX_CCC_THREADS);
+    numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numPeaks, peak, Xpeaks, Ypeaks, nxPad, nyPad, alignLimit, limitXshift, \
+  limitYshift, needBinA, nxUseA, nyUseA, nxUseC, nyUseC, minPixel, altCCC, altNumPix) \
+  private(ind, jPeak, tempX, tempY)
+    for (ind = 0; ind < 4 * numPeaks; ind++) {
+      jPeak = ind / 4;
+      altNumPix[ind] = -1;
+      if (peak[jPeak] < -1.e29 || peak[jPeak] < peak[0] * mPeakStrengthToEval)
+        continue;
+      tempX = Xpeaks[jPeak];
+      if (ind % 2)
+        tempX += tempX < 0 ? nxPad : -nxPad;
+      tempY = Ypeaks[jPeak];
+      if ((ind / 2) % 2)
+        tempY += tempY < 0 ? nyPad : -nyPad;
+      if (alignLimit > 0. && sqrt(pow(tempX + limitXshift, 2) +
+        pow(tempY + limitYshift, 2)) * needBinA > alignLimit)
+        continue;
+      altCCC[ind] = (float)CCCoefficientTwoPads(mCrray, mArray, nxPad + 2, nxPad, nyPad,
+        tempX, tempY, (nxPad - nxUseC) / 2, (nyPad - nyUseC) / 2 + 2,
+        (nxPad - nxUseA) / 2 + 2, (nyPad - nyUseA) / 2 + 2, minPixel, &altNumPix[ind]);
+    }
+  }
   bestWgtCCC = -10.;
   CCCbest = 0.;
   fracBest = 0.;
@@ -1256,9 +1373,14 @@ int CShiftManager::AutoAlign(int bufIndex, int inSmallPad, BOOL doImShift, int c
         if (alignLimit > 0. && sqrt(pow(xPeak[ix] + limitXshift, 2) +
           pow(yPeak[iy] + limitYshift, 2)) * needBinA > alignLimit)
           continue;
-        CCChere = CCCoefficientTwoPads(mCrray, mArray,nxPad + 2, nxPad, nyPad,
-          xPeak[ix], yPeak[iy], (nxPad - nxUseC) / 2, (nyPad - nyUseC) / 2 + 2,
-          (nxPad - nxUseA) / 2 + 2, (nyPad - nyUseA) / 2 + 2 , minPixel, &numPixel);
+        if (preEval) {
+          CCChere = altCCC[4 * iPeak + 2 * iy + ix];
+          numPixel = altNumPix[4 * iPeak + 2 * iy + ix];
+        } else {
+          CCChere = CCCoefficientTwoPads(mCrray, mArray,nxPad + 2, nxPad, nyPad,
+            xPeak[ix], yPeak[iy], (nxPad - nxUseC) / 2, (nyPad - nyUseC) / 2 + 2,
+            (nxPad - nxUseA) / 2 + 2, (nyPad - nyUseA) / 2 + 2 , minPixel, &numPixel);
+        }
         if (numPixel >= minPixel) {
           fracHere = (float)numPixel / (B3DMIN(nxUseA, nxUseC) * B3DMIN(nyUseA, nyUseC));
           wgtCCC = CCChere * pow((double)fracHere, overlapPow);
@@ -1388,10 +1510,10 @@ int CShiftManager::AutoAlign(int bufIndex, int inSmallPad, BOOL doImShift, int c
   }
 
   if (debugTime)
-    PrintfToLog("%.1f to bin, %.1f to stretch/erase, %.1f to pad, %.1f to correlate\r\n"
-    "%.1f to find %d peaks and get CCCs",
+    PrintfToLog("%.1f to bin, %.1f to stretch/erase, %.1f to pad, %.1f to correlate%s"
+    "\r\n%.1f to find %d peaks and get CCCs",
     time1 - startTime, time2 - time1, time3 - time2, time4 - time3,
-    time5 - time4, numRealPeaks);
+    useKeptRef ? " with kept reference" : "", time5 - time4, numRealPeaks);
 
   // If shift values are desired, set them and skip the rest of this, but apply the
   // adjustement to the expected shift for scaling
@@ -1609,6 +1731,55 @@ void CShiftManager::AutoalignCleanup()
 
 }
 
+// Turn on or off the keeping of the filtered reference spectrum between calls to
+// AutoAlign, for a series of alignments to the same reference; turning off frees arrays.
+// With chain set, the spectrum of the image being aligned is kept instead, for a series
+// where each image becomes the reference for the next one.  With retain set, existing
+// arrays are not freed, so a spectrum can be reused when keeping is turned on again
+void CShiftManager::SetKeepRefSpectrum(bool inVal, bool chain, bool retain)
+{
+  mKeepRefSpectrum = inVal;
+  mChainRefSpectrum = inVal && chain;
+  if (retain)
+    return;
+  delete [] mRefSpectrum;
+  delete [] mRefFiltered;
+  mRefSpectrum = NULL;
+  mRefFiltered = NULL;
+  mRefSpecImage = NULL;
+  mRefSpecSize = 0;
+}
+
+// Make sure the arrays for the kept spectrum and filtered image are the given size;
+// the image is cleared so that nothing matches until the keys are stored
+bool CShiftManager::AllocRefSpectrum(size_t arrSize)
+{
+  mRefSpecImage = NULL;
+  if (mRefSpectrum && mRefFiltered && arrSize == mRefSpecSize)
+    return true;
+  SetKeepRefSpectrum(mKeepRefSpectrum, mChainRefSpectrum);
+  NewArray(mRefSpectrum, float, arrSize);
+  NewArray(mRefFiltered, float, arrSize);
+  if (!mRefSpectrum || !mRefFiltered) {
+    SetKeepRefSpectrum(mKeepRefSpectrum, mChainRefSpectrum);
+    return false;
+  }
+  mRefSpecSize = arrSize;
+  return true;
+}
+
+// Save the parameters that the kept spectrum was made with, including the image, its
+// buffer time stamp in case the address is reused, and the filter
+void CShiftManager::StoreRefSpecKeys(int *refKey, float delta, KImage *image,
+  double timeStamp)
+{
+  memcpy(mRefSpecKey, refKey, sizeof(mRefSpecKey));
+  memcpy(mRefSpecCTF, mCTFa, sizeof(mCTFa));
+  mRefSpecDelta = delta;
+  mRefSpecImage = image;
+  mRefSpecTimeStamp = timeStamp;
+}
+
 ////////////////////////////////////////////////////////////////////
 // RESET IMAGE SHIFT
 ////////////////////////////////////////////////////////////////////
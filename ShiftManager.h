@@ -151,6 +151,9 @@ public:
   int FindAutoAlignBinnings(int heightA, int widthA, int binA, int heightC, int widthC,
     int binC, BOOL autoCorr, int &needBinA, int &needBinC, int &commonBin, int &size, CString &errStr);
   void AutoalignCleanup();
+  void SetKeepRefSpectrum(bool inVal, bool chain = false, bool retain = false);
+  bool AllocRefSpectrum(size_t arrSize);
+  void StoreRefSpecKeys(int *refKey, float delta, KImage *image, double timeStamp);
   BOOL MemoryError(BOOL inTest);
   BOOL ImageShiftIsOK(double newX, double newY, BOOL incremental);
   int SetAlignShifts(float inX, float inY, BOOL incremental, EMimageBuffer *imBuf,
@@ -244,6 +247,16 @@ private:
   KImage *mTmplImage;
   int mTmplBinning;
   float mNextAutoalignLimit;   // Limit in microns for next autoalignment
+  bool mKeepRefSpectrum;       // Flag to keep filtered reference spectrum between aligns
+  bool mChainRefSpectrum;      // Flag to keep spectrum of aligned image for next align
+  size_t mRefSpecSize;         // Size of the kept arrays
+  float *mRefSpectrum;         // Kept filtered spectrum of padded reference
+  float *mRefFiltered;         // Kept filtered reference image for CCCs
+  KImage *mRefSpecImage;       // Reference image it was made from
+  int mRefSpecKey[10];         // Sizes and limits it was made with
+  float mRefSpecDelta;         // Filter delta it was made with
+  float mRefSpecCTF[8193];     // And filter
+  double mRefSpecTimeStamp;    // Time stamp of buffer with the image
   BOOL mMouseShifting;         // Flag that image is shifting with mouse, ImShift deferred
   float mMouseStartX;          // Starting shifts in the image when button down
   float mMouseStartY;
@@ -0,0 +1,932 @@
+// SimulatedPlugin.cpp:  A built-in scope and camera plugin that simulates stage motion,
+//                         optics state, and images of a holey grid, for running
+//                         acquisition procedures without hardware
+//
+// Copyright (C) 2003-2026 by the Regents of the University of
+// Colorado.  See Copyright.txt for full notice of copyright and limitations.
+//
+// Author: David Mastronarde
+//////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <math.h>
+#include "SerialEM.h"
+#include "SimulatedPlugin.h"
+#include "EMscope.h"
+#include "Utilities\XCorr.h"
+#include "Shared\b3dutil.h"
+
+#if defined(_DEBUG) && defined(_CRTDBG_MAP_ALLOC)
+#define new DEBUG_NEW
+#endif
+
+#define SIM_NUM_CAMERAS 4
+#define SIM_TEX_SIZE 256
+#define SIM_PIX_PER_THREAD 100000.
+#define SIM_MAX_THREADS 8
+#define SIM_MIN_MAG_TO_START 5000
+
+static SimulatorParams sParams = {0, 25.f, 500.f, 10.f, 0.f, 100.f, 5.f, 1, 1.2f, 2.5f,
+  50.f, 0.6f, 2.f, 30.f};
+static HANDLE sSimMutex = NULL;
+static char sErrString[256] = "";
+
+// Scope state, in the units that the FEI plugin uses
+static double sStageX = 0., sStageY = 0., sStageZ = 0., sTiltAngle = 0., sBAxis = 0.;
+static int sStageBusy = 0;
+static double sImageShiftX = 0., sImageShiftY = 0.;
+static double sBeamShiftX = 0., sBeamShiftY = 0.;
+static double sBeamTiltX = 0., sBeamTiltY = 0.;
+static double sImBeamTiltX = 0., sImBeamTiltY = 0.;
+static double sDFTiltX = 0., sDFTiltY = 0.;
+static double sDiffShiftX = 0., sDiffShiftY = 0.;
+static double sObjStigX = 0., sObjStigY = 0.;
+static double sCondStigX = 0., sCondStigY = 0.;
+static double sDiffStigX = 0., sDiffStigY = 0.;
+static double sFocus = 0., sFocusOffset = 0.;
+static double sIntensity = 0.5, sIllumArea = 1.e-4, sImageDistOffset = 0.;
+static double sSTEMmag = 10000., sHighVoltage = 300000.;
+static int sMagIndex = 0, sCamLenIndex = 1, sSpotSize = 5, sMainScreen = spUp;
+static int sSTEMmode = 0, sProbeMode = imMicroProbe, sEFTEMmode = 0;
+static int sImagingMode = pmImaging, sDarkFieldMode = 0, sGunValve = 1;
+static BOOL sBeamBlanked = false;
+
+// Drift after the last stage move
+static double sDriftStartTime = 0., sDriftAngle = 0.;
+
+// Camera state
+static int sCamSizeX[SIM_NUM_CAMERAS] = {4096, 4096, 4096, 4096};
+static int sCamSizeY[SIM_NUM_CAMERAS] = {4096, 4096, 4096, 4096};
+static int sCamera = 0, sAreaTop = 0, sAreaLeft = 0, sAreaSizeX = 0, sAreaSizeY = 0;
+static int sBinning = 1;
+static double sExposure = 1.;
+
+// Texture tile and the conditions it was made for
+static float *sTexture = NULL;
+static double sTexDefocus = -1.e10, sTexPixel = 0.;
+
+// Statistics for the benchmark report
+static int sNumImages = 0, sNumMoves = 0;
+static double sStatStartTime = 0., sMoveSeconds = 0., sExposureSeconds = 0.;
+
+SimulatorParams *SimPlugGetParams()
+{
+  return &sParams;
+}
+
+static void SimLock()
+{
+  WaitForSingleObject(sSimMutex, INFINITE);
+}
+
+static void SimUnlock()
+{
+  ReleaseMutex(sSimMutex);
+}
+
+// Impose the per-call scope latency
+static void SimCallDelay()
+{
+  if (sParams.scopeCallMsec >= 1.)
+    Sleep((DWORD)sParams.scopeCallMsec);
+}
+
+static void SimInitState()
+{
+  if (sSimMutex)
+    return;
+  sSimMutex = CreateMutex(0, 0, 0);
+  sStatStartTime = wallTime();
+  sDriftStartTime = sStatStartTime;
+}
+
+// Simple random numbers that can be used from multiple threads with separate seeds
+static inline float SimRandom(unsigned int &seed)
+{
+  seed = 1664525 * seed + 1013904223;
+  return (float)(seed >> 8) / 16777216.f;
+}
+
+// Approximate gaussian with mean 0 and SD 1
+static inline float SimGaussian(unsigned int &seed)
+{
+  return 1.732051f * (SimRandom(seed) + SimRandom(seed) + SimRandom(seed) +
+    SimRandom(seed) - 2.f);
+}
+
+/////////////////////////////////////////////////
+// SCOPE FUNCTIONS
+/////////////////////////////////////////////////
+
+#define SIM_GET_SET_TWO(a, x, y) \
+static void SimGet##a(double *outX, double *outY) \
+{ SimCallDelay(); SimLock(); *outX = x; *outY = y; SimUnlock(); } \
+static void SimSet##a(double inX, double inY) \
+{ SimCallDelay(); SimLock(); x = inX; y = inY; SimUnlock(); }
+
+#define SIM_GET_SET_ONE(a, t, v) \
+static t SimGet##a() \
+{ t val; SimCallDelay(); SimLock(); val = v; SimUnlock(); return val; } \
+static void SimSet##a(t inVal) \
+{ SimCallDelay(); SimLock(); v = inVal; SimUnlock(); }
+
+SIM_GET_SET_TWO(ImageShift, sImageShiftX, sImageShiftY)
+SIM_GET_SET_TWO(BeamShift, sBeamShiftX, sBeamShiftY)
+SIM_GET_SET_TWO(BeamTilt, sBeamTiltX, sBeamTiltY)
+SIM_GET_SET_TWO(ImageBeamTilt, sImBeamTiltX, sImBeamTiltY)
+SIM_GET_SET_TWO(DarkFieldTilt, sDFTiltX, sDFTiltY)
+SIM_GET_SET_TWO(DiffractionShift, sDiffShiftX, sDiffShiftY)
+SIM_GET_SET_TWO(ObjectiveStigmator, sObjStigX, sObjStigY)
+SIM_GET_SET_TWO(CondenserStigmator, sCondStigX, sCondStigY)
+SIM_GET_SET_TWO(DiffractionStigmator, sDiffStigX, sDiffStigY)
+SIM_GET_SET_ONE(Intensity, double, sIntensity)
+SIM_GET_SET_ONE(IlluminatedArea, double, sIllumArea)
+SIM_GET_SET_ONE(ImageDistanceOffset, double, sImageDistOffset)
+SIM_GET_SET_ONE(STEMMagnification, double, sSTEMmag)
+SIM_GET_SET_ONE(SpotSize, int, sSpotSize)
+SIM_GET_SET_ONE(MainScreen, int, sMainScreen)
+SIM_GET_SET_ONE(STEMMode, int, sSTEMmode)
+SIM_GET_SET_ONE(ProbeMode, int, sProbeMode)
+SIM_GET_SET_ONE(EFTEMMode, int, sEFTEMmode)
+SIM_GET_SET_ONE(ImagingMode, int, sImagingMode)
+SIM_GET_SET_ONE(DarkFieldMode, int, sDarkFieldMode)
+SIM_GET_SET_ONE(CameraLengthIndex, int, sCamLenIndex)
+
+static double SimGetDefocus()
+{
+  double val;
+  SimCallDelay();
+  SimLock();
+  val = sFocus - sFocusOffset;
+  SimUnlock();
+  return val;
+}
+
+static void SimSetDefocus(double inVal)
+{
+  SimCallDelay();
+  SimLock();
+  sFocus = inVal + sFocusOffset;
+  SimUnlock();
+}
+
+static void SimResetDefocus()
+{
+  SimCallDelay();
+  SimLock();
+  sFocusOffset = sFocus;
+  SimUnlock();
+}
+
+static double SimGetAbsFocus()
+{
+  double val;
+  SimCallDelay();
+  SimLock();
+  val = sFocus * 1.e6;
+  SimUnlock();
+  return val;
+}
+
+static void SimSetAbsFocus(double inVal)
+{
+  SimCallDelay();
+  SimLock();
+  sFocus = inVal * 1.e-6;
+  SimUnlock();
+}
+
+static int SimGetMagnificationIndex()
+{
+  int val;
+  SimCallDelay();
+  SimLock();
+  val = sMagIndex;
+  SimUnlock();
+  return val;
+}
+
+// Accept only indexes with an entry in the mag table
+static void SimSetMagnificationIndex(int inVal)
+{
+  MagTable *magTab = SEMGetMagTable();
+  SimCallDelay();
+  if (inVal < 0 || inVal >= MAX_MAGS || (inVal > 0 && !magTab[inVal].mag))
+    return;
+  SimLock();
+  sMagIndex = inVal;
+  SimUnlock();
+}
+
+static double SimGetMagnification()
+{
+  int magInd = SimGetMagnificationIndex();
+  return magInd ? SEMGetMagTable()[magInd].mag : 0.;
+}
+
+static double SimGetCameraLength()
+{
+  double val;
+  SimCallDelay();
+  SimLock();
+  val = sMagIndex ? 0. : 0.1 * sCamLenIndex;
+  SimUnlock();
+  return val;
+}
+
+static int SimGetSubMode()
+{
+  SimCallDelay();
+  return 0;
+}
+
+static double SimGetTiltAngle()
+{
+  double val;
+  SimCallDelay();
+  SimLock();
+  val = sTiltAngle;
+  SimUnlock();
+  return val;
+}
+
+static int SimGetStageStatus()
+{
+  int val;
+  SimCallDelay();
+  SimLock();
+  val = sStageBusy;
+  SimUnlock();
+  return val;
+}
+
+static double SimGetStageBAxis()
+{
+  double val;
+  SimCallDelay();
+  SimLock();
+  val = sBAxis;
+  SimUnlock();
+  return val;
+}
+
+static void SimGetStagePosition(double *x, double *y, double *z)
+{
+  SimCallDelay();
+  SimLock();
+  *x = sStageX;
+  *y = sStageY;
+  *z = sStageZ;
+  SimUnlock();
+}
+
+// Move the stage synchronously, taking a time based on the travel and speed, and
+// start a new drift in a random direction
+static void SimMoveStage(double x, double y, double z, double alpha, double beta,
+  double speed, int axisBits)
+{
+  static unsigned int seed = 12345;
+  double dist = 0., tiltDist = 0., msec;
+  SimCallDelay();
+  SimLock();
+  if (axisBits & axisX)
+    dist = B3DMAX(dist, fabs(x - sStageX) * 1.e6);
+  if (axisBits & axisY)
+    dist = B3DMAX(dist, fabs(y - sStageY) * 1.e6);
+  if (axisBits & axisZ)
+    dist = B3DMAX(dist, fabs(z - sStageZ) * 1.e6);
+  if (axisBits & axisA)
+    tiltDist = fabs(alpha - sTiltAngle) / DTOR;
+  if (axisBits & axisB)
+    tiltDist = B3DMAX(tiltDist, fabs(beta - sBAxis) / DTOR);
+  sStageBusy = 1;
+  SimUnlock();
+  speed = B3DMAX(0.01, B3DMIN(1., speed));
+  msec = sParams.stageSettleMsec +
+    1000. * (dist / B3DMAX(0.1, sParams.stageSpeed * speed) +
+    tiltDist / B3DMAX(0.1, sParams.tiltSpeed * speed));
+  Sleep((DWORD)msec);
+  SimLock();
+  if (axisBits & axisX)
+    sStageX = x;
+  if (axisBits & axisY)
+    sStageY = y;
+  if (axisBits & axisZ)
+    sStageZ = z;
+  if (axisBits & axisA)
+    sTiltAngle = alpha;
+  if (axisBits & axisB)
+    sBAxis = beta;
+  sDriftStartTime = wallTime();
+  sDriftAngle = 2. * 3.14159265 * SimRandom(seed);
+  sNumMoves++;
+  sMoveSeconds += msec / 1000.;
+  sStageBusy = 0;
+  SimUnlock();
+}
+
+static void SimSetStagePosition(double x, double y, double z, double alpha, int axisBits)
+{
+  SimMoveStage(x, y, z, alpha, 0., 1., axisBits & ~axisB);
+}
+
+static void SimSetStagePositionExtra(double x, double y, double z, double alpha,
+  double beta, double speed, int axisBits)
+{
+  SimMoveStage(x, y, z, alpha, beta, speed, axisBits);
+}
+
+static BOOL SimGetBeamBlank()
+{
+  BOOL val;
+  SimCallDelay();
+  SimLock();
+  val = sBeamBlanked;
+  SimUnlock();
+  return val;
+}
+
+static void SimSetBeamBlank(PLUGIN_BOOL inVal)
+{
+  SimCallDelay();
+  SimLock();
+  sBeamBlanked = (bool)inVal;
+  SimUnlock();
+}
+
+static int SimGetGunValve()
+{
+  int val;
+  SimCallDelay();
+  SimLock();
+  val = sGunValve;
+  SimUnlock();
+  return val;
+}
+
+static void SimSetGunValve(PLUGIN_BOOL inVal)
+{
+  SimCallDelay();
+  SimLock();
+  sGunValve = (bool)inVal ? 1 : 0;
+  SimUnlock();
+}
+
+static double SimGetHighVoltage()
+{
+  double val;
+  SimCallDelay();
+  SimLock();
+  val = sHighVoltage;
+  SimUnlock();
+  return val;
+}
+
+static void SimSetHighVoltage(double inVal)
+{
+  SimCallDelay();
+  SimLock();
+  sHighVoltage = inVal;
+  SimUnlock();
+}
+
+// Screen current in amps, assuming one count per electron over the whole camera
+static double SimGetScreenCurrent()
+{
+  bool noBeam;
+  SimCallDelay();
+  SimLock();
+  noBeam = sBeamBlanked || !sGunValve || sMainScreen != spDown;
+  SimUnlock();
+  if (noBeam)
+    return 0.;
+  return sParams.countsPerSec * sCamSizeX[0] * sCamSizeY[0] * 1.602e-19;
+}
+
+static double SimGetZeroDbl()
+{
+  SimCallDelay();
+  return 0.;
+}
+
+static BOOL SimGetFalse()
+{
+  SimCallDelay();
+  return false;
+}
+
+static void SimNoOpInt(int inVal)
+{
+  SimCallDelay();
+}
+
+static void SimNoOpBool(PLUGIN_BOOL inVal)
+{
+  SimCallDelay();
+}
+
+// Start at a moderate mag if nothing has been set
+static void SimInitializeScope()
+{
+  MagTable *magTab = SEMGetMagTable();
+  SimInitState();
+  for (int ind = 1; ind < MAX_MAGS && !sMagIndex; ind++)
+    if (magTab[ind].mag >= SIM_MIN_MAG_TO_START)
+      sMagIndex = ind;
+  if (!sMagIndex)
+    sMagIndex = 1;
+}
+
+static void SimUninitializeScope()
+{
+}
+
+static const char *SimGetLastErrorString()
+{
+  return sErrString;
+}
+
+static int SimGetPluginVersions(int *plugVers, int *servVers)
+{
+  *plugVers = FEISCOPE_PLUGIN_VERSION;
+  return 0;
+}
+
+static int SimGetNumStartupErrors(int *numErr, int *lastCall)
+{
+  *numErr = 0;
+  *lastCall = 0;
+  return 0;
+}
+
+static int SimBeginThreadAccess(int numCalls, int flags)
+{
+  return 0;
+}
+
+static void SimEndThreadAccess(int flags)
+{
+}
+
+// For every function that is not simulated: like a real plugin, set the error string
+// and throw
+static void SimNotSimulated()
+{
+  strcpy(sErrString, "This function is not available in the simulated microscope");
+  throw(_com_error((HRESULT)PLUGIN_FAKE_HRESULT, NULL, true));
+}
+
+// Stand-in with the right signature for a function pointer type; it never returns
+template <typename F> struct SimStub;
+template <typename R, typename... A> struct SimStub<R (*)(A...)> {
+  static R NotSimulated(A...) { SimNotSimulated(); return R(); }
+};
+
+// Fill the scope function table.  Functions whose existence callers test before using
+// them are left NULL so those features are skipped; every other one not simulated gets
+// a stub that throws an error, since many calls are made without testing
+void SimPlugFillScopeFuncs(ScopePluginFuncs *funcs)
+{
+  SimInitState();
+  memset(funcs, 0, sizeof(ScopePluginFuncs));
+  funcs->GetIsSmallScreenDown = SimGetFalse;
+  funcs->GetPluginVersions = SimGetPluginVersions;
+  funcs->GetImageShift = SimGetImageShift;
+  funcs->SetImageShift = SimSetImageShift;
+  funcs->GetBeamShift = SimGetBeamShift;
+  funcs->SetBeamShift = SimSetBeamShift;
+  funcs->GetBeamTilt = SimGetBeamTilt;
+  funcs->SetBeamTilt = SimSetBeamTilt;
+  funcs->GetImageBeamTilt = SimGetImageBeamTilt;
+  funcs->SetImageBeamTilt = SimSetImageBeamTilt;
+  funcs->GetDarkFieldTilt = SimGetDarkFieldTilt;
+  funcs->SetDarkFieldTilt = SimSetDarkFieldTilt;
+  funcs->GetDiffractionShift = SimGetDiffractionShift;
+  funcs->SetDiffractionShift = SimSetDiffractionShift;
+  funcs->GetObjectiveStigmator = SimGetObjectiveStigmator;
+  funcs->SetObjectiveStigmator = SimSetObjectiveStigmator;
+  funcs->GetCondenserStigmator = SimGetCondenserStigmator;
+  funcs->SetCondenserStigmator = SimSetCondenserStigmator;
+  funcs->GetDiffractionStigmator = SimGetDiffractionStigmator;
+  funcs->SetDiffractionStigmator = SimSetDiffractionStigmator;
+  funcs->NormalizeLens = SimNoOpInt;
+  funcs->SetAutoNormEnabled = SimNoOpBool;
+  funcs->GetBeamBlank = SimGetBeamBlank;
+  funcs->SetBeamBlank = SimSetBeamBlank;
+  funcs->GetHighVoltage = SimGetHighVoltage;
+  funcs->SetHighVoltage = SimSetHighVoltage;
+  funcs->GetGunValve = SimGetGunValve;
+  funcs->SetGunValve = SimSetGunValve;
+  funcs->GetScreenCurrent = SimGetScreenCurrent;
+  funcs->GetMainScreen = SimGetMainScreen;
+  funcs->SetMainScreen = SimSetMainScreen;
+  funcs->GetAbsFocus = SimGetAbsFocus;
+  funcs->SetAbsFocus = SimSetAbsFocus;
+  funcs->ResetDefocus = SimResetDefocus;
+  funcs->GetDefocus = SimGetDefocus;
+  funcs->SetDefocus = SimSetDefocus;
+  funcs->GetTiltAngle = SimGetTiltAngle;
+  funcs->GetStageStatus = SimGetStageStatus;
+  funcs->GetStageBAxis = SimGetStageBAxis;
+  funcs->GetStagePosition = SimGetStagePosition;
+  funcs->SetStagePosition = SimSetStagePosition;
+  funcs->SetStagePositionExtra = SimSetStagePositionExtra;
+  funcs->GetSTEMMode = SimGetSTEMMode;
+  funcs->SetSTEMMode = SimSetSTEMMode;
+  funcs->GetProbeMode = SimGetProbeMode;
+  funcs->SetProbeMode = SimSetProbeMode;
+  funcs->GetIntensityZoom = SimGetFalse;
+  funcs->SetIntensityZoom = SimNoOpBool;
+  funcs->GetEFTEMMode = SimGetEFTEMMode;
+  funcs->SetEFTEMMode = SimSetEFTEMMode;
+  funcs->GetImagingMode = SimGetImagingMode;
+  funcs->SetImagingMode = SimSetImagingMode;
+  funcs->GetSubMode = SimGetSubMode;
+  funcs->GetDarkFieldMode = SimGetDarkFieldMode;
+  funcs->SetDarkFieldMode = SimSetDarkFieldMode;
+  funcs->GetSpotSize = SimGetSpotSize;
+  funcs->SetSpotSize = SimSetSpotSize;
+  funcs->GetIntensity = SimGetIntensity;
+  funcs->SetIntensity = SimSetIntensity;
+  funcs->GetIlluminatedArea = SimGetIlluminatedArea;
+  funcs->SetIlluminatedArea = SimSetIlluminatedArea;
+  funcs->GetImageDistanceOffset = SimGetImageDistanceOffset;
+  funcs->SetImageDistanceOffset = SimSetImageDistanceOffset;
+  funcs->GetConvergenceAngle = SimGetZeroDbl;
+  funcs->GetFEGBeamCurrent = SimGetZeroDbl;
+  funcs->GetMagnificationIndex = SimGetMagnificationIndex;
+  funcs->SetMagnificationIndex = SimSetMagnificationIndex;
+  funcs->GetSTEMMagnification = SimGetSTEMMagnification;
+  funcs->SetSTEMMagnification = SimSetSTEMMagnification;
+  funcs->GetMagnification = SimGetMagnification;
+  funcs->GetCameraLength = SimGetCameraLength;
+  funcs->GetCameraLengthIndex = SimGetCameraLengthIndex;
+  funcs->SetCameraLengthIndex = SimSetCameraLengthIndex;
+  funcs->GetImageRotation = SimGetZeroDbl;
+  funcs->GetObjectiveStrength = SimGetZeroDbl;
+  funcs->InitializeScope = SimInitializeScope;
+  funcs->UninitializeScope = SimUninitializeScope;
+  funcs->GetLastErrorString = SimGetLastErrorString;
+  funcs->ScopeIsDisconnected = SimGetFalse;
+  funcs->GetNumStartupErrors = SimGetNumStartupErrors;
+  funcs->BeginThreadAccess = SimBeginThreadAccess;
+  funcs->EndThreadAccess = SimEndThreadAccess;
+
+  // Give a stub to each entry still empty, expanding the list that defines the table
+#define SIM_STUB(t, a) if (!funcs->a) funcs->a = SimStub<t>::NotSimulated
+#define GET_ONE_INT(a) SIM_STUB(ScopeGetInt, a)
+#define GET_ONE_BOOL(a) SIM_STUB(ScopeGetBool, a)
+#define GET_ONE_DBL(a) SIM_STUB(ScopeGetDbl, a)
+#define GET_TWO_DBL(a) SIM_STUB(ScopeGetTwoDbl, a)
+#define SET_ONE_INT(a) SIM_STUB(ScopeSetInt, a)
+#define SET_ONE_BOOL(a) SIM_STUB(ScopeSetBool, a)
+#define SET_ONE_DBL(a) SIM_STUB(ScopeSetDbl, a)
+#define SET_TWO_DBL(a) SIM_STUB(ScopeSetTwoDbl, a)
+#define CALL_NO_ARGS(a) SIM_STUB(ScopeNoArg, a)
+#define MATCHING_NAMES_ONLY
+#define SCOPE_SAMENAME(t, a) SIM_STUB(t, a)
+#include "StandardScopeCalls.h"
+#undef MATCHING_NAMES_ONLY
+
+  // Then clear the optional ones
+#define SIM_OPTIONAL(t, a) if (funcs->a == SimStub<t>::NotSimulated) funcs->a = NULL
+  SIM_OPTIONAL(ScopeSetInt, DoingUpdate);
+  SIM_OPTIONAL(ScopeSetInt, GetValuesFast);
+  SIM_OPTIONAL(ScopeSetInt, SkipAdvancedScripting);
+  SIM_OPTIONAL(ServiceNames, UtapiServiceNames);
+  SIM_OPTIONAL(ScopeNoArg, UtapiStopContinuous);
+  SIM_OPTIONAL(ASIsubarea, ASIsetCameraSubarea);
+  SIM_OPTIONAL(ScopeGetSetInt, GetFlashingAdvised);
+  SIM_OPTIONAL(CamOneInt, FlashFEG);
+  SIM_OPTIONAL(CamNoArg, FocusRamperInitialize);
+  SIM_OPTIONAL(ScopeGetInt, GetEmissionState);
+  SIM_OPTIONAL(CamOneInt, SetEmissionState);
+  SIM_OPTIONAL(ScopeGetDbl, GetFilamentCurrent);
+  SIM_OPTIONAL(ScopeSetDbl, SetFilamentCurrent);
+  SIM_OPTIONAL(ScopeGetInt, GetBeamStopper);
+  SIM_OPTIONAL(ScopeSetInt, SetBeamStopper);
+  SIM_OPTIONAL(ScopeGetGauge, GetGaugePressure);
+  SIM_OPTIONAL(ScopeSetIntGetIntDbl, GetNitrogenInfo);
+  SIM_OPTIONAL(CartridgeInfo, GetCartridgeInfo);
+  SIM_OPTIONAL(ScopeGetInt, GetLoadedSlot);
+  SIM_OPTIONAL(ScopeGetInt, GetFilmStock);
+  SIM_OPTIONAL(ScopeSetBool, SetScreenDim);
+  SIM_OPTIONAL(ScopeNoArg, RestoreStageSpeed);
+  SIM_OPTIONAL(ScopeGetSetInt, GetVibrationState);
+  SIM_OPTIONAL(ScopeSetInt, SetVibrationAvoidance);
+  SIM_OPTIONAL(CamOneInt, GetApertureSize);
+  SIM_OPTIONAL(ScopeSetTwoInt, SetApertureSize);
+  SIM_OPTIONAL(ScopeSetIntGetTwoDbl, GetAperturePosition);
+  SIM_OPTIONAL(ScopeSetIntTwoDbl, SetAperturePosition);
+  SIM_OPTIONAL(ScopeGetInt, GetCurPhasePlatePos);
+  SIM_OPTIONAL(ScopeGetSetInt, GoToNextPhasePlatePos);
+  SIM_OPTIONAL(ScopeGetTwoDblByName, GetDeflectorByName);
+  SIM_OPTIONAL(ScopeSet2DblIntByName, SetDeflectorByName);
+  SIM_OPTIONAL(ScopeGetDblByName, GetLensByName);
+  SIM_OPTIONAL(ScopeSetDblByName, SetLensByName);
+  SIM_OPTIONAL(ScopeSetIntGetIntDbl, GetLensFLCStatus);
+  SIM_OPTIONAL(ScopeSetTwoIntDbl, SetLensWithFLC);
+  SIM_OPTIONAL(ScopeSetTwoInt, SetFreeLensControl);
+  SIM_OPTIONAL(ScopeSetDbl, SetDiffractionFocus);
+  SIM_OPTIONAL(GetBrightContrast, GetDetectorBrightContrast);
+  SIM_OPTIONAL(SetBrightContrast, SetDetectorBrightContrast);
+  SIM_OPTIONAL(ScopeGetTwoDbl, GetPiezoXYPosition);
+  SIM_OPTIONAL(ScopeSetTwoDbl, SetPiezoXYPosition);
+  SIM_OPTIONAL(ScopeGetInt, GetXLensModeAvailable);
+#undef SIM_OPTIONAL
+#undef SIM_STUB
+}
+
+/////////////////////////////////////////////////
+// CAMERA FUNCTIONS
+/////////////////////////////////////////////////
+
+static int SimGetNumberOfCameras()
+{
+  return SIM_NUM_CAMERAS;
+}
+
+static int SimInitializeCamera(int camera)
+{
+  SimInitState();
+  return 0;
+}
+
+static int SimUninitializeCameras()
+{
+  return 0;
+}
+
+static int SimSelectCamera(int camera)
+{
+  if (camera < 0 || camera >= SIM_NUM_CAMERAS) {
+    sprintf(sErrString, "Camera number %d is out of range", camera);
+    return 1;
+  }
+  sCamera = camera;
+  return 0;
+}
+
+static int SimSetExposure(double exposure, double settling)
+{
+  sExposure = B3DMAX(0., exposure);
+  return 0;
+}
+
+// Area is passed in unbinned coordinates
+static int SimSetAcquiredArea(int top, int left, int sizeX, int sizeY, int binning)
+{
+  sAreaTop = top;
+  sAreaLeft = left;
+  sAreaSizeX = sizeX;
+  sAreaSizeY = sizeY;
+  sBinning = B3DMAX(1, binning);
+  return 0;
+}
+
+static int SimReturnZero(int inVal)
+{
+  return 0;
+}
+
+static int SimIsCameraInserted(int camera)
+{
+  return 1;
+}
+
+static int SimSetCameraInsertion(int camera, int insert)
+{
+  return 0;
+}
+
+static int SimSetSizeOfCamera(int camera, int sizeX, int sizeY)
+{
+  if (camera < 0 || camera >= SIM_NUM_CAMERAS)
+    return 1;
+  sCamSizeX[camera] = sizeX;
+  sCamSizeY[camera] = sizeY;
+  return 0;
+}
+
+static int SimGetCameraSize(int *sizeX, int *sizeY)
+{
+  *sizeX = sCamSizeX[sCamera];
+  *sizeY = sCamSizeY[sCamera];
+  return 0;
+}
+
+static int SimStopContinuous()
+{
+  return 0;
+}
+
+// Make a tile of noise filtered by a CTF for the given defocus in microns (negative for
+// underfocus) and pixel size in nm, scaled to unit SD
+static void SimMakeTexture(double defocus, double pixel)
+{
+  int ix, iy, dir, nx = SIM_TEX_SIZE, ny = SIM_TEX_SIZE, nxDim = SIM_TEX_SIZE + 2;
+  unsigned int seed = 54321;
+  double kx, ky, k2, chi, sum = 0., sumsq = 0., sd;
+  double volts = sHighVoltage > 0 ? sHighVoltage : 300000.;
+  double lambda = 1.226 / sqrt(volts * (1. + 0.9785e-6 * volts));
+  float scale;
+  if (!sTexture)
+    sTexture = new float[nxDim * ny];
+  for (iy = 0; iy < ny; iy++)
+    for (ix = 0; ix < nx; ix++)
+      sTexture[ix + iy * nxDim] = SimRandom(seed);
+  dir = 0;
+  twoDfft(sTexture, &nx, &ny, &dir);
+  for (iy = 0; iy < ny; iy++) {
+    ky = (iy <= ny / 2 ? iy : iy - ny) / (ny * pixel);
+    for (ix = 0; ix <= nx / 2; ix++) {
+      kx = ix / (nx * pixel);
+      k2 = kx * kx + ky * ky;
+      chi = -3.14159265 * lambda * defocus * 1000. * k2;
+      scale = (float)(sin(chi) * exp(-k2 * pixel * pixel * 2.));
+      sTexture[2 * ix + iy * nxDim] *= scale;
+      sTexture[2 * ix + 1 + iy * nxDim] *= scale;
+    }
+  }
+  sTexture[0] = sTexture[1] = 0.;
+  dir = 1;
+  twoDfft(sTexture, &nx, &ny, &dir);
+  for (iy = 0; iy < ny; iy++) {
+    for (ix = 0; ix < nx; ix++) {
+      sum += sTexture[ix + iy * nxDim];
+      sumsq += sTexture[ix + iy * nxDim] * sTexture[ix + iy * nxDim];
+    }
+  }
+  sum /= nx * ny;
+  sd = sqrt(B3DMAX(0., sumsq / (nx * ny) - sum * sum));
+  scale = (float)(sd > 0. ? 1. / sd : 0.);
+  for (iy = 0; iy < ny; iy++)
+    for (ix = 0; ix < nx; ix++)
+      sTexture[ix + iy * nxDim] = (float)(sTexture[ix + iy * nxDim] - sum) * scale;
+  sTexDefocus = defocus;
+  sTexPixel = pixel;
+}
+
+// Synthesize an image of the holey grid at the current stage position, image shift and
+// drift, with shot noise.  The time for the exposure and readout is simulated by
+// sleeping for whatever part of it was not taken by the computation
+static int SimAcquireImage(short *array, int arrSize, int processing, int *sizeX,
+  int *sizeY)
+{
+  static unsigned int frameSeed = 1;
+  int nx, ny, numThreads, bin = sBinning;
+  double startTime = wallTime(), elapsed, pixel = 0., driftDist, drift, tau, tilt;
+  double centX, centY, posX, posY, defocus, btiltX, btiltY;
+  float mean, carbonMean, texScale, radSq, spacing, *texture;
+  unsigned int baseSeed;
+  MagTable *magTab = SEMGetMagTable();
+
+  nx = (sAreaSizeX > 0 ? sAreaSizeX : sCamSizeX[sCamera]) / bin;
+  ny = (sAreaSizeY > 0 ? sAreaSizeY : sCamSizeY[sCamera]) / bin;
+  if (nx * ny > arrSize) {
+    sprintf(sErrString, "Array of size %d is too small for %d x %d image", arrSize, nx,
+      ny);
+    return 1;
+  }
+  *sizeX = nx;
+  *sizeY = ny;
+
+  // Snapshot the scope state
+  SimLock();
+  tau = sParams.driftDecay;
+  elapsed = startTime - sDriftStartTime + sExposure / 2.;
+  driftDist = tau > 0 ? sParams.driftRate * tau * (1. - exp(-elapsed / tau)) :
+    sParams.driftRate * elapsed;
+  drift = driftDist / 1000.;
+  posX = sStageX * 1.e6 + sImageShiftX + drift * cos(sDriftAngle);
+  posY = sStageY * 1.e6 + sImageShiftY + drift * sin(sDriftAngle);
+  defocus = (sFocus + sStageZ) * 1.e6;
+  btiltX = sBeamTiltX + sImBeamTiltX;
+  btiltY = sBeamTiltY + sImBeamTiltY;
+  tilt = cos(sTiltAngle);
+  if (sMagIndex > 0 && sMagIndex < MAX_MAGS && magTab[sMagIndex].mag > 0)
+    pixel = 1000. * sParams.pixelMicrons * bin / magTab[sMagIndex].mag;
+  SimUnlock();
+
+  // Beam tilt displaces the image in proportion to defocus
+  posX += defocus * btiltX;
+  posY += defocus * btiltY;
+  mean = (float)(sParams.countsPerSec * sExposure * bin * bin);
+  if (sBeamBlanked || !sGunValve || sMainScreen == spDown || pixel <= 0.)
+    mean = 0.;
+  carbonMean = mean * sParams.carbonTransmission;
+  if (sParams.makeTexture && mean > 0. && (fabs(defocus - sTexDefocus) > 0.05 ||
+    fabs(pixel - sTexPixel) > 0.001 * pixel))
+    SimMakeTexture(defocus, pixel);
+  texture = sTexture;
+  texScale = (sParams.makeTexture && texture) ? 0.1f * carbonMean : 0.f;
+  radSq = sParams.holeDiameter * sParams.holeDiameter / 4.f;
+  spacing = B3DMAX(0.01f, sParams.holeSpacing);
+  centX = (sCamSizeX[sCamera] / 2. - sAreaLeft) / bin;
+  centY = (sCamSizeY[sCamera] / 2. - sAreaTop) / bin;
+  pixel /= 1000.;
+  baseSeed = frameSeed++ * 7919;
+
+  numThreads = B3DNINT((double)nx * ny / SIM_PIX_PER_THREAD);
+  B3DCLAMP(numThreads, 1, SIM_MAX_THREADS);
+  numThreads = numOMPthreads(numThreads);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(array, nx, ny, posX, posY, centX, centY, pixel, tilt, spacing, radSq, mean, \
+  carbonMean, texScale, texture, baseSeed)
+  for (int iy = 0; iy < ny; iy++) {
+    unsigned int seed = baseSeed + iy * 104729;
+    double sx, sy, fx, fy;
+    float val;
+    int ix, texY, texX;
+    short *line = array + iy * nx;
+    sy = posY - (iy + 0.5 - centY) * pixel;
+    fy = sy / spacing - floor(sy / spacing + 0.5);
+    fy *= spacing;
+    texY = ((int)floor(sy / pixel) & (SIM_TEX_SIZE - 1)) * (SIM_TEX_SIZE + 2);
+    for (ix = 0; ix < nx; ix++) {
+      sx = posX + (ix + 0.5 - centX) * pixel / tilt;
+      fx = sx / spacing - floor(sx / spacing + 0.5);
+      fx *= spacing;
+      if (fx * fx + fy * fy < radSq) {
+        val = mean;
+      } else {
+        val = carbonMean;
+        if (texScale) {
+          texX = (int)floor(sx / pixel) & (SIM_TEX_SIZE - 1);
+          val += texScale * texture[texX + texY];
+        }
+      }
+      val += (float)sqrt(B3DMAX(0.f, val)) * SimGaussian(seed);
+      line[ix] = (short)B3DNINT(B3DMAX(0.f, B3DMIN(32767.f, val)));
+    }
+  }
+
+  SimLock();
+  sNumImages++;
+  sExposureSeconds += sExposure;
+  SimUnlock();
+  elapsed = 1000. * (sExposure - (wallTime() - startTime)) + sParams.readoutMsec;
+  if (elapsed >= 1.)
+    Sleep((DWORD)elapsed);
+  return 0;
+}
+
+void SimPlugFillCameraFuncs(CamPluginFuncs *funcs)
+{
+  SimInitState();
+  memset(funcs, 0, sizeof(CamPluginFuncs));
+  funcs->GetNumberOfCameras = SimGetNumberOfCameras;
+  funcs->InitializeCamera = SimInitializeCamera;
+  funcs->UninitializeCameras = SimUninitializeCameras;
+  funcs->SelectCamera = SimSelectCamera;
+  funcs->SetExposure = SimSetExposure;
+  funcs->SetAcquiredArea = SimSetAcquiredArea;
+  funcs->AcquireImage = SimAcquireImage;
+  funcs->SetDebugMode = SimReturnZero;
+  funcs->IsCameraInserted = SimIsCameraInserted;
+  funcs->SetCameraInsertion = SimSetCameraInsertion;
+  funcs->SetSizeOfCamera = SimSetSizeOfCamera;
+  funcs->StopContinuous = SimStopContinuous;
+  funcs->GetLastErrorString = SimGetLastErrorString;
+  funcs->GetCameraSize = SimGetCameraSize;
+}
+
+/////////////////////////////////////////////////
+// SCRIPT-CALLABLE FUNCTIONS
+/////////////////////////////////////////////////
+
+// Report images and stage moves per hour since the last reset, return images per hour
+static double SimReportStatistics()
+{
+  double hours = (wallTime() - sStatStartTime) / 3600.;
+  double perHour = hours > 0. ? sNumImages / hours : 0.;
+  PrintfToLog("Simulator: %d images (%.1f/hour), %d stage moves (%.1f/hour) in %.1f "
+    "minutes", sNumImages, perHour, sNumMoves, hours > 0. ? sNumMoves / hours : 0.,
+    hours * 60.);
+  PrintfToLog("   %.1f sec of exposure, %.1f sec of stage movement", sExposureSeconds,
+    sMoveSeconds);
+  return perHour;
+}
+
+static double SimResetStatistics()
+{
+  SimLock();
+  sNumImages = sNumMoves = 0;
+  sMoveSeconds = sExposureSeconds = 0.;
+  sStatStartTime = wallTime();
+  SimUnlock();
+  return 0.;
+}
+
+void SimPlugAddScriptCalls(CArray<PluginCall, PluginCall> &calls)
+{
+  PluginCall call;
+  call.numInts = call.numDbls = call.ifString = call.flags = 0;
+  call.beforeTSaction = call.tiltIndexDone = -1;
+  call.name = "ReportStatistics";
+  call.func = SimReportStatistics;
+  calls.Add(call);
+  call.name = "ResetStatistics";
+  call.func = SimResetStatistics;
+  calls.Add(call);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "PluginManager.h"
+
+// Bits for the SimulatedScopeAndCamera property
+#define SIMPLUG_SCOPE   1
+#define SIMPLUG_CAMERA  2
+
+// Parameters for the simulated scope and camera, set from properties
+struct SimulatorParams {
+  int enable;                 // Sum of SIMPLUG_ bits to enable scope and/or camera
+  float stageSpeed;           // Stage speed in microns/sec
+  float stageSettleMsec;      // Fixed time added to every stage move
+  float tiltSpeed;            // Tilt speed in degrees/sec
+  float scopeCallMsec;        // Delay added to each scope get/set call
+  float readoutMsec;          // Camera readout time added to exposure
+  float pixelMicrons;         // Physical pixel size of the camera
+  int makeTexture;            // 1 to add defocus-dependent texture to the carbon
+  float holeDiameter;         // Diameter of holes in microns
+  float holeSpacing;          // Center-to-center spacing of hole lattice in microns
+  float countsPerSec;         // Counts per unbinned pixel per second over a hole
+  float carbonTransmission;   // Fraction of beam transmitted through carbon
+  float driftRate;            // Initial drift rate after a stage move in nm/sec
+  float driftDecay;           // Time constant of drift decay in sec
+};
+
+SimulatorParams *SimPlugGetParams();
+void SimPlugFillScopeFuncs(ScopePluginFuncs *funcs);
+void SimPlugFillCameraFuncs(CamPluginFuncs *funcs);
+void SimPlugAddScriptCalls(CArray<PluginCall, PluginCall> &calls);
@@ -366,6 +366,9 @@ CTSController::CTSController()
   mDoingTS = false;
   mStartedTS = false;
   mVerbose = true;
+  mActionTimeCat = -1;
+  mSettleEndTime = -1.;
+  mNumTimedTilts = 0;
   mAutosaveLog = false;
   mAutosaveXYZ = false;
   mDebugMode = false;
@@ -1171,6 +1174,9 @@ int CTSController::StartTiltSeries(BOOL singleStep, int external, CMapDrawItem *
     mTiltIndex = 0;
     SetFileZ();
     mHaveRecordRef = false;
+    mNumTimedTilts = 0;
+    for (i = 0; i < TS_TIME_NUM; i++)
+      mSumStepTimes[i] = 0.;
 
     if (navItem && navItem->mParallelTSIndex >= 0 && ParallelTSSetup(navItem, str)) {
       SEMMessageBox(str);
@@ -1648,6 +1654,10 @@ int CTSController::CommonResume(int inSingle, int external, bool stoppingPart)
   mScopeEventDoneTime = -1.;
   mTerminationStarted = false;
   mTermOnErrorCalled = false;
+  mActionTimeCat = -1;
+  mSettleEndTime = -1.;
+  for (i = 0; i < TS_TIME_NUM; i++)
+    mStepTimes[i] = 0.;
   mWinApp->mPluginManager->ResumingTiltSeries(mTiltIndex);
 
   // If valves haven't been closed ever, set one-shot based on the current state of flag
@@ -2255,6 +2265,7 @@ void CTSController::NextAction(int param)
         PrintfToLog("Running script # %d", mMacroToRun);
       }
         mRunningMacro = true;
+        MarkActionTime(TS_TIME_OTHER);
         mWinApp->mMacroProcessor->Run(mMacroToRun - 1);
         mWinApp->AddIdleTask(TASK_TILT_SERIES, 0, 0);
         return;
@@ -2795,6 +2806,7 @@ void CTSController::NextAction(int param)
       message += message2;
       mWinApp->SetNextLogColorStyle(0, 1);
       mWinApp->AppendToLog(message, LOG_OPEN_IF_CLOSED);
+      ReportTiltTiming();
       if (mAutosaveLog)
         mWinApp->mLogWindow->UpdateSaveFile(true, mWinApp->mStoreMRC->getName());
       mDidFocus[mTiltIndex] = false;
@@ -3482,6 +3494,7 @@ BOOL CTSController::NextActionIs(int nextIndex, int action, int testStep)
 {
   BOOL retval = NextActionIsReally(nextIndex, action, testStep);
   if (retval) {
+    MarkActionTime(ActionTimeCategory(action));
     DebugDump(actionText[B3DMAX(0, action - 1)][0]);
     if (testStep > 0 && mSingleStep < 0) {
       if (!mDebugMode)
@@ -3492,6 +3505,139 @@ BOOL CTSController::NextActionIs(int nextIndex, int action, int testStep)
   return retval;
 }
 
+// Return the category for the per-tilt timing breakdown that an action belongs to
+int CTSController::ActionTimeCategory(int action)
+{
+  switch (action) {
+  case TILT_IF_NEEDED:
+  case REVERSE_TILT:
+  case BIDIR_RETURN_TO_START:
+  case BIDIR_REVERSE_TILT:
+  case PREWALK_REVERSE_TILT:
+  case WALK_UP:
+    return TS_TIME_TILT;
+
+  case WAIT_FOR_DRIFT:
+    return TS_TIME_SETTLE;
+
+  case AUTOFOCUS:
+  case SAVE_AUTOFOCUS:
+  case CHECK_AUTOFOCUS:
+  case EVALUATE_AUTOFOCUS:
+  case STARTUP_AUTOFOCUS:
+  case SAVE_STARTUP_AUTOFOCUS:
+  case BIDIR_AUTOFOCUS:
+    return TS_TIME_FOCUS;
+
+  case LOW_MAG_FOR_TRACKING:
+  case ALIGN_LOW_MAG_SHOT:
+  case TRACKING_SHOT:
+  case ALIGN_TRACKING_SHOT:
+  case POST_FOCUS_TRACKING:
+  case ALIGN_POST_FOCUS:
+  case TRACK_BEFORE_LOWMAG_REF:
+  case ALIGN_LOWMAG_PRETRACK:
+  case LOW_MAG_REFERENCE:
+  case COPY_LOW_MAG_REF:
+  case LOWDOSE_PREVIEW:
+  case ALIGN_LOWDOSE_PREVIEW:
+  case LOWDOSE_TRACK_REF:
+  case COPY_LOWDOSE_REF:
+  case DOSYM_ANCHOR_SHOT:
+  case DOSYM_REALIGN_SHOT:
+  case BIDIR_REALIGN_SHOT:
+  case BIDIR_TRACK_SHOT:
+  case BIDIR_ALIGN_TRACK:
+  case BIDIR_LOWMAG_REF:
+  case BIDIR_COPY_LOWMAG_REF:
+    return TS_TIME_TRACK;
+
+  case RECORD_OR_MONTAGE:
+  case GET_DEFERRED_SUM:
+  case EXTRA_RECORD:
+    return TS_TIME_RECORD;
+
+  case SAVE_RECORD_SHOT:
+  case SAVE_EXTRA_RECORD:
+    return TS_TIME_SAVE;
+  }
+  return TS_TIME_OTHER;
+}
+
+// Add the time since the last action started to the category of that action and start
+// timing one in the given category.  Time spent within the tilt delay after a tilt
+// (which is imposed when the next shot is taken) is counted as settling
+void CTSController::MarkActionTime(int category)
+{
+  double lastTilt, now = GetTickCount();
+  float elapsed, settle = 0.;
+  if (mActionTimeCat >= 0) {
+    elapsed = (float)(SEMTickInterval(now, mActionStartTime) / 1000.);
+    if (mSettleEndTime > 0. && mActionTimeCat != TS_TIME_TILT) {
+      settle = (float)(SEMTickInterval(B3DMIN(now, mSettleEndTime),
+        B3DMAX(mActionStartTime, mSettleStartTime)) / 1000.);
+      B3DCLAMP(settle, 0.f, elapsed);
+      if (now >= mSettleEndTime)
+        mSettleEndTime = -1.;
+    }
+    mStepTimes[mActionTimeCat] += elapsed - settle;
+    mStepTimes[TS_TIME_SETTLE] += settle;
+
+    // At the end of a tilt, set up the settling interval
+    lastTilt = mScope->GetLastTiltTime();
+    if (mActionTimeCat == TS_TIME_TILT && SEMTickInterval(lastTilt, mActionStartTime) > 0) {
+      mSettleStartTime = now;
+      mSettleEndTime = lastTilt +
+        (double)mShiftManager->GetAdjustedTiltDelay(mScope->GetLastTiltChange());
+    }
+  }
+  mActionTimeCat = category;
+  mActionStartTime = now;
+}
+
+// Report the time in each category since the last Record was saved, add to the sums,
+// and start the next interval
+void CTSController::ReportTiltTiming()
+{
+  int ind;
+  float total = 0.;
+  MarkActionTime(TS_TIME_SAVE);
+  for (ind = 0; ind < TS_TIME_NUM; ind++) {
+    total += mStepTimes[ind];
+    mSumStepTimes[ind] += mStepTimes[ind];
+  }
+  mNumTimedTilts++;
+  SEMTrace('t', "Tilt timing: tilt %.1f  settle %.1f  focus %.1f  track %.1f  record "
+    "%.1f  save %.1f  other %.1f  total %.1f sec", mStepTimes[TS_TIME_TILT],
+    mStepTimes[TS_TIME_SETTLE], mStepTimes[TS_TIME_FOCUS], mStepTimes[TS_TIME_TRACK],
+    mStepTimes[TS_TIME_RECORD], mStepTimes[TS_TIME_SAVE], mStepTimes[TS_TIME_OTHER],
+    total);
+  for (ind = 0; ind < TS_TIME_NUM; ind++)
+    mStepTimes[ind] = 0.;
+}
+
+// Report the average time per tilt in each category over the series
+void CTSController::ReportTimingSummary()
+{
+  int ind;
+  double total = 0.;
+  CString mess;
+  if (mNumTimedTilts < 2)
+    return;
+  for (ind = 0; ind < TS_TIME_NUM; ind++)
+    total += mSumStepTimes[ind] / mNumTimedTilts;
+  mess.Format("Average time per tilt over %d tilts: %.1f sec (tilt %.1f  settle %.1f  "
+    "focus %.1f  track %.1f  record %.1f  save %.1f  other %.1f)", mNumTimedTilts, total,
+    mSumStepTimes[TS_TIME_TILT] / mNumTimedTilts,
+    mSumStepTimes[TS_TIME_SETTLE] / mNumTimedTilts,
+    mSumStepTimes[TS_TIME_FOCUS] / mNumTimedTilts,
+    mSumStepTimes[TS_TIME_TRACK] / mNumTimedTilts,
+    mSumStepTimes[TS_TIME_RECORD] / mNumTimedTilts,
+    mSumStepTimes[TS_TIME_SAVE] / mNumTimedTilts,
+    mSumStepTimes[TS_TIME_OTHER] / mNumTimedTilts);
+  mWinApp->VerboseAppendToLog(mVerbose, mess);
+}
+
 BOOL CTSController::NextActionIsReally(int nextIndex, int action, int testStep)
 {
   if (nextIndex != mActOrder[action])
@@ -4717,8 +4863,11 @@ int CTSController::EndControl(BOOL terminating, BOOL startReorder)
     !mWinApp->mNavigator->FindNextAcquireItem(i);
   if (!mTerminationStarted)
     DELETE_ARR(mEndCtlMdocPath);
-  if (terminating)
+  if (terminating) {
+    if (!mTerminationStarted)
+      ReportTimingSummary();
     mTerminationStarted = true;
+  }
   if (!mClosedDoseSymFile && mWinApp->mStoreMRC) {
     mNumMdocFiles = 1;
     mEndCtlWidth = mWinApp->mStoreMRC->getWidth();
@@ -17,6 +17,8 @@ enum {BIDIR_NONE = 0, BIDIR_FIRST_PART, BIDIR_RETURN_PHASE, BIDIR_SECOND_PART,
 enum {TSMACRO_PRE_TRACK1 = 1, TSMACRO_PRE_FOCUS, TSMACRO_PRE_TRACK2, TSMACRO_PRE_RECORD};
 #define MAX_TSMACRO_STEPS 5
 enum {DEFSUM_LOOP, DEFSUM_NORMAL_STOP, DEFSUM_ERROR_STOP, DEFSUM_TERM_ERROR};
+enum {TS_TIME_TILT = 0, TS_TIME_SETTLE, TS_TIME_FOCUS, TS_TIME_TRACK, TS_TIME_RECORD,
+  TS_TIME_SAVE, TS_TIME_OTHER, TS_TIME_NUM};
 #define TS_CHECK_DEWARS 1
 #define TS_CHECK_PVP     2
 #define NAV_OVERRIDE_TILT        1
@@ -457,6 +459,13 @@ private:
   BOOL mDidFocus[MAX_TS_TILTS];
   float mTimes[MAX_TS_TILTS];
   float mTrueStartTilt;       // Actual starting tilt angle
+  int mActionTimeCat;         // Timing category of current action, or -1 if none
+  double mActionStartTime;    // Time that action started
+  double mSettleStartTime;    // Time the last tilt finished
+  double mSettleEndTime;      // Time that the tilt delay after it runs out
+  float mStepTimes[TS_TIME_NUM];   // Seconds in each category since last saved Record
+  double mSumStepTimes[TS_TIME_NUM];   // Sums of those over the timed tilts
+  int mNumTimedTilts;         // Number of tilts in the sums
   int mMaxDisturbValidChange; // Max disturbances to pass over looking for valid change
   int mMaxDropAsShiftDisturbed;   // Max # of points to drop from X/Y after disturbance
   int mMaxDropAsFocusDisturbed;   // Max # of points to drop from Z after disturbance
@@ -647,6 +656,10 @@ public:
   int SetExtraRecordState(void);
   void RestoreFromExtraRec(void);
   int CheckSaveLowTiltMap();
+  int ActionTimeCategory(int action);
+  void MarkActionTime(int category);
+  void ReportTiltTiming();
+  void ReportTimingSummary();
   void ReviseLowTiltMapSection();
   void SyncParamToOtherModules(void);
   void SyncOtherModulesToParam(void);
@@ -1173,285 +1173,330 @@ void XCorrFastInterp(void *array, int type, void *bray, int nxa, int nya,
 }
 
 
-// calculate the mean of an array within the given limits
-double ProcImageMean(void *array, int type, int nx, int ny, int ix0, int ix1,
-           int iy0, int iy1)
+#define MAX_STAT_THREADS 8
+
+// Get the number of threads for computing statistics on an area, about one per megapixel
+static int StatisticsThreads(int ix0, int ix1, int iy0, int iy1)
 {
-  double sum = 0.;
-  int tsum, ix, iy;
-  unsigned char *bdata;
-  short int *sdata;
-  unsigned short int *usdata;
-  float *fdata;
-  double fsum;
+  int numThreads = (int)((double)(ix1 + 1 - ix0) * (iy1 + 1 - iy0) / 1.e6);
+  B3DCLAMP(numThreads, 1, MAX_STAT_THREADS);
+  numThreads = B3DMAX(1, B3DMIN(numThreads, iy1 + 1 - iy0));
+  return numOMPthreads(numThreads);
+}
+
+// Kernel for LineRangeSums on one line of data of type T, with values of type V shifted
+// by ref and line sums of type S.  The loops have no branches so they can be vectorized
+template <typename T, typename V, typename S>
+static void LineSumsKernel(T *data, int nxUse, bool doSq, V ref, V &vMin, V &vMax,
+  double &sum, double &sumSq)
+{
+  int ix;
+  V val, lMin = vMin, lMax = vMax;
+  S lsum = 0;
+  double lsumSq = 0.;
+  if (doSq) {
+    for (ix = 0; ix < nxUse; ix++) {
+      val = (V)data[ix] - ref;
+      lsum += val;
+      lsumSq += (double)val * val;
+      ACCUM_MIN(lMin, val);
+      ACCUM_MAX(lMax, val);
+    }
+    vMin = lMin;
+    vMax = lMax;
+    sumSq += lsumSq;
+  } else {
+    for (ix = 0; ix < nxUse; ix++)
+      lsum += data[ix];
+  }
+  sum += lsum;
+}
 
+// Compute the sum of the values over a range of lines of an area, and optionally the
+// sum of squares and the min and max.  Values are shifted by the reference value for
+// the sums of squares to limit loss of precision; the min and max are not shifted
+static void LineRangeSums(void *array, int type, int nx, int ix0, int ix1, int iy0,
+  int iy1, bool doSq, double ref, double &sum, double &sumSq, float &dmin, float &dmax)
+{
+  int iy, nxUse = ix1 + 1 - ix0;
+  int iref = (int)ref;
+  int iMin = 2000000000, iMax = -iMin;
+  float fref = (float)ref, fMin = 1.e38f, fMax = -1.e38f;
+  size_t offset;
+
+  sum = sumSq = 0.;
   for (iy = iy0; iy <= iy1; iy++) {
-    tsum = 0;
+    offset = (size_t)nx * iy + ix0;
     switch (type) {
     case BYTE:
-      bdata = (unsigned char *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++)
-        tsum += *bdata++;
+      LineSumsKernel<unsigned char, int, int>((unsigned char *)array + offset, nxUse,
+        doSq, iref, iMin, iMax, sum, sumSq);
       break;
-
     case SIGNED_SHORT:
-      sdata = (short int *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++)
-        tsum += *sdata++;
+      LineSumsKernel<short int, int, int>((short int *)array + offset, nxUse, doSq,
+        iref, iMin, iMax, sum, sumSq);
       break;
-
     case UNSIGNED_SHORT:
-      usdata = (unsigned short int *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++)
-        tsum += *usdata++;
+      LineSumsKernel<unsigned short int, int, int>((unsigned short int *)array + offset,
+        nxUse, doSq, iref, iMin, iMax, sum, sumSq);
       break;
-
     case FLOAT:
-      fsum = 0.;
-      fdata = (float *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++)
-        fsum += *fdata++;
-      sum += fsum;
+      LineSumsKernel<float, float, double>((float *)array + offset, nxUse, doSq, fref,
+        fMin, fMax, sum, sumSq);
       break;
     }
-    sum += tsum;
   }
-  return sum / ((ix1 + 1 - ix0) * (iy1 + 1 - iy0));
+  if (doSq) {
+    dmin = (float)(type == FLOAT ? fMin + fref : iMin + iref);
+    dmax = (float)(type == FLOAT ? fMax + fref : iMax + iref);
+  }
+}
+
+// calculate the mean of an array within the given limits
+double ProcImageMean(void *array, int type, int nx, int ny, int ix0, int ix1,
+           int iy0, int iy1)
+{
+  double sum = 0., sums[MAX_STAT_THREADS], sumSq;
+  float dmin, dmax;
+  int thr, iyStart, iyEnd;
+  int numThreads = StatisticsThreads(ix0, ix1, iy0, iy1);
+  int linesPer = (iy1 + numThreads - iy0) / numThreads;
+
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numThreads, linesPer, array, type, nx, ix0, ix1, iy0, iy1, sums) \
+  private(thr, iyStart, iyEnd, sumSq, dmin, dmax)
+  for (thr = 0; thr < numThreads; thr++) {
+    iyStart = iy0 + thr * linesPer;
+    iyEnd = B3DMIN(iy1, iyStart + linesPer - 1);
+    sums[thr] = 0.;
+    if (iyStart <= iyEnd)
+      LineRangeSums(array, type, nx, ix0, ix1, iyStart, iyEnd, false, 0., sums[thr],
+        sumSq, dmin, dmax);
+  }
+  for (thr = 0; thr < numThreads; thr++)
+    sum += sums[thr];
+  return sum / ((double)(ix1 + 1 - ix0) * (iy1 + 1 - iy0));
 }
 
 // Calculate the mean of a circular area specified by center point and radius
 double ProcImageMeanCircle(void *array, int type, int nx, int ny, int cx, int cy,
   int radius)
 {
-  double sum = 0.;
-  int area = 0;
-  int ix0, ix1, iy0, iy1;
-  int ysquared;
-  int tsum, ix, iy;
-  unsigned char *bdata;
-  short int *sdata;
-  unsigned short int *usdata;
-  float *fdata;
-  double fsum;
+  double sum = 0., lineSum, sumSq;
+  double area = 0.;
+  int iy0, iy1, ix0, ix1, iy, dx, remain;
+  float dmin, dmax;
   int radSquared = radius * radius;
 
-  ix0 = B3DMAX(0, cx - radius);
-  ix1 = B3DMIN(nx - 1, cx + radius);
   iy0 = B3DMAX(0, cy - radius);
   iy1 = B3DMIN(ny - 1, cy + radius);
 
+  // Get the extent of the circle on each line directly instead of testing each pixel
   for (iy = iy0; iy <= iy1; iy++) {
-    tsum = 0;
-    ysquared = (cy - iy) * (cy - iy);
-    switch (type) {
-    case BYTE:
-      bdata = (unsigned char *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++) {
-        if ((cx - ix) * (cx - ix) + ysquared <= radSquared) {
-          tsum += *bdata;
-          area++;
-        }
-        *bdata++;
-      }
-      break;
-
-    case SIGNED_SHORT:
-      sdata = (short int *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++) {
-        if ((cx - ix) * (cx - ix) + ysquared <= radSquared) {
-          tsum += *sdata;
-          area++;
-        }
-        *sdata++;
-      }
-      break;
-
-    case UNSIGNED_SHORT:
-      usdata = (unsigned short int *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++) {
-        if ((cx - ix) * (cx - ix) + ysquared <= radSquared) {
-          tsum += *usdata;
-          area++;
-        }
-        *usdata++;
-      }
-      break;
-
-    case FLOAT:
-      fsum = 0.;
-      fdata = (float *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++) {
-        if ((cx - ix) * (cx - ix) + ysquared <= radSquared) {
-          fsum += *fdata;
-          area++;
-        }
-        *fdata++;
-      }
-      sum += fsum;
-      break;
-    }
-    sum += tsum;
+    remain = radSquared - (cy - iy) * (cy - iy);
+    dx = (int)sqrt((double)remain);
+    while ((dx + 1) * (dx + 1) <= remain)
+      dx++;
+    while (dx * dx > remain)
+      dx--;
+    ix0 = B3DMAX(0, cx - dx);
+    ix1 = B3DMIN(nx - 1, cx + dx);
+    if (ix0 > ix1)
+      continue;
+    LineRangeSums(array, type, nx, ix0, ix1, iy, iy, false, 0., lineSum, sumSq, dmin,
+      dmax);
+    sum += lineSum;
+    area += ix1 + 1 - ix0;
   }
   if (!area)
     return 0.;
   return sum / area;
 }
 
-// Compute the min, max, mean and sd of the defined area of an image
+// Compute the min, max, mean and sd of the defined area of an image in one pass
 void ProcMinMaxMeanSD(void *array, int type, int nx, int ny, int ix0, int ix1,
            int iy0, int iy1, float *mean, float *min, float *max, float *sd)
 {
-  double tmean = ProcImageMean(array, type, nx, ny, ix0, ix1, iy0, iy1);
-  *mean = tmean;
-  int iMin = 1000000;
-  int iMax = -iMin;
-  double tsum, sxsq = 0.;
-  int ix, iy, ival;
-  unsigned char *bdata;
-  short int *sdata;
-  unsigned short int *usdata;
-  float *fdata;
-  float fval;
-  float fMin = 1.e38f;
-  float fMax = -fMin;
+  double sums[MAX_STAT_THREADS], sumSqs[MAX_STAT_THREADS];
+  float mins[MAX_STAT_THREADS], maxes[MAX_STAT_THREADS];
+  double sum = 0., sumSq = 0., tmean;
+  double numPix = (double)(ix1 + 1 - ix0) * (iy1 + 1 - iy0);
+  int thr, iyStart, iyEnd;
+  int numThreads = StatisticsThreads(ix0, ix1, iy0, iy1);
+  int linesPer = (iy1 + numThreads - iy0) / numThreads;
+
+  // Use the first pixel as the reference for the shifted sums
+  double ref = 0.;
+  if (type == BYTE || type == SIGNED_SHORT || type == UNSIGNED_SHORT || type == FLOAT)
+    ref = ProcGetPixel(array, type, nx, ix0, iy0);
 
-  for (iy = iy0; iy <= iy1; iy++) {
-    tsum = 0;
-    switch (type) {
-    case BYTE:
-      bdata = (unsigned char *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++) {
-        ival = *bdata++;
-        if (ival < iMin)
-          iMin = ival;
-        if (ival > iMax)
-          iMax = ival;
-        tsum += (ival - tmean) * (ival - tmean);
-      }
-      break;
-
-    case SIGNED_SHORT:
-      sdata = (short int *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++) {
-        ival = *sdata++;
-        if (ival < iMin)
-          iMin = ival;
-        if (ival > iMax)
-          iMax = ival;
-        tsum += (ival - tmean) * (ival - tmean);
-      }
-      break;
-
-    case UNSIGNED_SHORT:
-      usdata = (unsigned short int *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++) {
-        ival = *usdata++;
-        if (ival < iMin)
-          iMin = ival;
-        if (ival > iMax)
-          iMax = ival;
-        tsum += (ival - tmean) * (ival - tmean);
-      }
-      break;
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numThreads, linesPer, array, type, nx, ix0, ix1, iy0, iy1, ref, sums, sumSqs, \
+  mins, maxes) \
+  private(thr, iyStart, iyEnd)
+  for (thr = 0; thr < numThreads; thr++) {
+    iyStart = iy0 + thr * linesPer;
+    iyEnd = B3DMIN(iy1, iyStart + linesPer - 1);
+    sums[thr] = sumSqs[thr] = 0.;
+    mins[thr] = 1.e38f;
+    maxes[thr] = -1.e38f;
+    if (iyStart <= iyEnd)
+      LineRangeSums(array, type, nx, ix0, ix1, iyStart, iyEnd, true, ref, sums[thr],
+        sumSqs[thr], mins[thr], maxes[thr]);
+  }
+
+  *min = mins[0];
+  *max = maxes[0];
+  for (thr = 0; thr < numThreads; thr++) {
+    sum += sums[thr];
+    sumSq += sumSqs[thr];
+    ACCUM_MIN(*min, mins[thr]);
+    ACCUM_MAX(*max, maxes[thr]);
+  }
+  tmean = sum / numPix;
+  *mean = (float)(tmean + ref);
+  *sd = 0.;
+  if (numPix > 1.)
+    *sd = (float)sqrt(B3DMAX(0., sumSq - tmean * sum) / (numPix - 1.));
+}
 
-    case FLOAT:
-      fdata = (float *)array + nx * iy + ix0;
-      for (ix = ix0; ix <= ix1; ix++) {
-        fval = *fdata++;
-        if (fval < fMin)
-          fMin = fval;
-        if (fval > fMax)
-          fMax = fval;
-        tsum += (fval - tmean) * (fval - tmean);
-      }
-      break;
+// Kernel for ProcCentroid: add the weighted sums for one line of data of type T
+template <typename T>
+static void CentroidLineSums(T *data, int ix0, int ix1, int iy, double baseval,
+  double thresh, double &xsum, double &ysum, double &wsum)
+{
+  int ix;
+  double tval;
+  for (ix = ix0; ix <= ix1; ix++) {
+    tval = *data++ - baseval;
+    tval = B3DMIN(tval, thresh);
+    if (tval > 0) {
+      xsum += ix * tval;
+      ysum += iy * tval;
+      wsum += tval;
     }
-    sxsq += tsum;
-  }
-  *sd = sqrt(sxsq / ((ix1 + 1 - ix0) * (iy1 + 1 - iy0) - 1));
-  if (type != FLOAT) {
-    *min = iMin;
-    *max = iMax;
-  } else {
-    *min = fMin;
-    *max = fMax;
   }
 }
 
-// Macro for ProcCentroid
-#define CENTROID_SUMS(tnam, data, typ) \
-    case tnam:  \
-data = (typ *)array + nx * iy + ix0; \
-for (ix = ix0; ix <= ix1; ix++) {  \
-  tval = *data++ - baseval;  \
-  tval = B3DMIN(tval, thresh);  \
-  if (tval > 0) {  \
-    xsum += ix * tval;  \
-    ysum += iy * tval;  \
-    wsum += tval;   \
-  }   \
-}  \
-break;
-
 // Compute the centroid of pixels in the defined area that are above the baseval
 void ProcCentroid(void *array, int type, int nx, int ny, int ix0, int ix1,
            int iy0, int iy1, double baseval, float &xcen, float &ycen, double thresh)
 {
-  double xsum = 0.;
-  double ysum = 0.;
-  double wsum = 0.;
-  double tval;
-  int ix, iy;
-  unsigned char *bdata;
-  short int *sdata;
-  unsigned short int *usdata;
-  float *fdata;
+  double xsums[MAX_STAT_THREADS], ysums[MAX_STAT_THREADS], wsums[MAX_STAT_THREADS];
+  double xsum, ysum, wsum;
+  int iy, thr, iyStart, iyEnd;
+  size_t offset;
+  int numThreads = StatisticsThreads(ix0, ix1, iy0, iy1);
+  int linesPer = (iy1 + numThreads - iy0) / numThreads;
 
-  for (iy = iy0; iy <= iy1; iy++) {
-    switch (type) {
-      CENTROID_SUMS(BYTE, bdata, unsigned char);
-      CENTROID_SUMS(SIGNED_SHORT, sdata, short int);
-      CENTROID_SUMS(UNSIGNED_SHORT, usdata, unsigned short int);
-      CENTROID_SUMS(FLOAT, fdata, float);
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numThreads, linesPer, array, type, nx, ix0, ix1, iy0, iy1, baseval, thresh, \
+  xsums, ysums, wsums) \
+  private(thr, iyStart, iyEnd, iy, offset, xsum, ysum, wsum)
+  for (thr = 0; thr < numThreads; thr++) {
+    iyStart = iy0 + thr * linesPer;
+    iyEnd = B3DMIN(iy1, iyStart + linesPer - 1);
+    xsum = ysum = wsum = 0.;
+    for (iy = iyStart; iy <= iyEnd; iy++) {
+      offset = (size_t)nx * iy + ix0;
+      switch (type) {
+      case BYTE:
+        CentroidLineSums((unsigned char *)array + offset, ix0, ix1, iy, baseval, thresh,
+          xsum, ysum, wsum);
+        break;
+      case SIGNED_SHORT:
+        CentroidLineSums((short int *)array + offset, ix0, ix1, iy, baseval, thresh,
+          xsum, ysum, wsum);
+        break;
+      case UNSIGNED_SHORT:
+        CentroidLineSums((unsigned short int *)array + offset, ix0, ix1, iy, baseval,
+          thresh, xsum, ysum, wsum);
+        break;
+      case FLOAT:
+        CentroidLineSums((float *)array + offset, ix0, ix1, iy, baseval, thresh, xsum,
+          ysum, wsum);
+        break;
+      }
     }
-  }
-  xcen = xsum / wsum;
-  ycen = ysum / wsum;
+    xsums[thr] = xsum;
+    ysums[thr] = ysum;
+    wsums[thr] = wsum;
+  }
+  xsum = ysum = wsum = 0.;
+  for (thr = 0; thr < numThreads; thr++) {
+    xsum += xsums[thr];
+    ysum += ysums[thr];
+    wsum += wsums[thr];
+  }
+  xcen = (float)(xsum / wsum);
+  ycen = (float)(ysum / wsum);
 }
 
-// Macro for ProcMomentsAboveThreshold
-#define MOMENT_SUMS(tnam, data, typ) \
-    case tnam:  \
-data = (typ *)array + nx * iy + ix0; \
-for (ix = ix0; ix <= ix1; ix++) {  \
-  if (*data++ > thresh) {  \
-    M11 += (iy - ycen) * (ix - xcen);  \
-    M20 += (iy - ycen) * (iy - ycen);  \
-    M02 += (ix - xcen) * (ix - xcen);  \
-  }   \
-}  \
-break;
+// Kernel for ProcMomentsAboveThreshold: add the moments for one line of data of type T
+template <typename T>
+static void MomentLineSums(T *data, int ix0, int ix1, int iy, double thresh, float xcen,
+  float ycen, double &m11, double &m20, double &m02)
+{
+  int ix;
+  for (ix = ix0; ix <= ix1; ix++) {
+    if (*data++ > thresh) {
+      m11 += (iy - ycen) * (ix - xcen);
+      m20 += (iy - ycen) * (iy - ycen);
+      m02 += (ix - xcen) * (ix - xcen);
+    }
+  }
+}
 
 // Compute unweighted second order moments of pixels above threshold in the given image
 void ProcMomentsAboveThreshold(void *array, int type, int nx, int ny, int ix0, int ix1,
   int iy0, int iy1, double thresh, float xcen, float ycen, double &M11,
   double &M20, double &M02)
 {
-  int ix, iy;
-  unsigned char *bdata;
-  short int *sdata;
-  unsigned short int *usdata;
-  float *fdata;
-  M11 = 0.;
-  M20 = 0.;
-  M02 = 0.;
-  for (iy = iy0; iy <= iy1; iy++) {
-    switch (type) {
-      MOMENT_SUMS(BYTE, bdata, unsigned char);
-      MOMENT_SUMS(SIGNED_SHORT, sdata, short int);
-      MOMENT_SUMS(UNSIGNED_SHORT, usdata, unsigned short int);
-      MOMENT_SUMS(FLOAT, fdata, float);
+  double m11s[MAX_STAT_THREADS], m20s[MAX_STAT_THREADS], m02s[MAX_STAT_THREADS];
+  double m11, m20, m02;
+  int iy, thr, iyStart, iyEnd;
+  size_t offset;
+  int numThreads = StatisticsThreads(ix0, ix1, iy0, iy1);
+  int linesPer = (iy1 + numThreads - iy0) / numThreads;
+
+#pragma omp parallel for num_threads(numThreads) \
+  shared(numThreads, linesPer, array, type, nx, ix0, ix1, iy0, iy1, thresh, xcen, ycen, \
+  m11s, m20s, m02s) \
+  private(thr, iyStart, iyEnd, iy, offset, m11, m20, m02)
+  for (thr = 0; thr < numThreads; thr++) {
+    iyStart = iy0 + thr * linesPer;
+    iyEnd = B3DMIN(iy1, iyStart + linesPer - 1);
+    m11 = m20 = m02 = 0.;
+    for (iy = iyStart; iy <= iyEnd; iy++) {
+      offset = (size_t)nx * iy + ix0;
+      switch (type) {
+      case BYTE:
+        MomentLineSums((unsigned char *)array + offset, ix0, ix1, iy, thresh, xcen, ycen,
+          m11, m20, m02);
+        break;
+      case SIGNED_SHORT:
+        MomentLineSums((short int *)array + offset, ix0, ix1, iy, thresh, xcen, ycen,
+          m11, m20, m02);
+        break;
+      case UNSIGNED_SHORT:
+        MomentLineSums((unsigned short int *)array + offset, ix0, ix1, iy, thresh, xcen,
+          ycen, m11, m20, m02);
+        break;
+      case FLOAT:
+        MomentLineSums((float *)array + offset, ix0, ix1, iy, thresh, xcen, ycen, m11,
+          m20, m02);
+        break;
+      }
     }
+    m11s[thr] = m11;
+    m20s[thr] = m20;
+    m02s[thr] = m02;
+  }
+  M11 = M20 = M02 = 0.;
+  for (thr = 0; thr < numThreads; thr++) {
+    M11 += m11s[thr];
+    M20 += m20s[thr];
+    M02 += m02s[thr];
   }
 }
 